@@ -0,0 +1,99 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "bitMatrix.h"
+
+BitMatrix* createBitMatrix(int dimension)
+{
+	BitMatrix* matrix = (BitMatrix*)malloc(sizeof(BitMatrix));
+
+	if (matrix == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
+	matrix->dimension = dimension;
+	matrix->wordsPerRow = (dimension + BIT_WORD - 1) / BIT_WORD;
+	matrix->words = (uint64_t*)calloc((size_t)dimension * matrix->wordsPerRow, sizeof(uint64_t));
+
+	if (matrix->words == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
+	return matrix;
+}
+
+BitMatrix* packBitMatrix(const int* bits, int dimension)
+{
+	BitMatrix* matrix = createBitMatrix(dimension);
+
+	for (int row = 0; row < dimension; row++)
+		for (int col = 0; col < dimension; col++)
+			if (bits[(long)row * dimension + col] != 0)
+				matrix->words[(long)row * matrix->wordsPerRow + col / BIT_WORD] |= (uint64_t)1 << (col % BIT_WORD);
+
+	return matrix;
+}
+
+void unpackBitMatrix(BitMatrix* matrix, int* bits)
+{
+	for (int row = 0; row < matrix->dimension; row++)
+		for (int col = 0; col < matrix->dimension; col++)
+			bits[(long)row * matrix->dimension + col] =
+				(matrix->words[(long)row * matrix->wordsPerRow + col / BIT_WORD] >> (col % BIT_WORD)) & 1;
+}
+
+// swap the off diagonal halves at every scale, the row index of a word picks its bit
+static void transposeWordBlock(uint64_t block[BIT_WORD])
+{
+	uint64_t mask = 0x00000000FFFFFFFFull;
+
+	for (int width = 32; width != 0; width >>= 1, mask ^= mask << width)
+		for (int row = 0; row < BIT_WORD; row = (row + width + 1) & ~width)
+		{
+			uint64_t swap = ((block[row] >> width) ^ block[row + width]) & mask;
+
+			block[row] ^= swap << width;
+			block[row + width] ^= swap;
+		}
+}
+
+// transpose 64 x 64 bit blocks, rows past the dimension read as zero
+BitMatrix* transposeBitMatrix(BitMatrix* matrix)
+{
+	int dimension = matrix->dimension;
+	int words = matrix->wordsPerRow;
+	BitMatrix* transposed = createBitMatrix(dimension);
+	uint64_t block[BIT_WORD];
+
+	for (int blockRow = 0; blockRow < words; blockRow++)
+		for (int blockCol = 0; blockCol < words; blockCol++)
+		{
+			for (int y = 0; y < BIT_WORD; y++)
+			{
+				int row = blockRow * BIT_WORD + y;
+				block[y] = row < dimension ? matrix->words[(long)row * words + blockCol] : 0;
+			}
+
+			transposeWordBlock(block);
+
+			for (int y = 0; y < BIT_WORD; y++)
+			{
+				int row = blockCol * BIT_WORD + y;
+
+				if (row < dimension)
+					transposed->words[(long)row * words + blockRow] = block[y];
+			}
+		}
+
+	return transposed;
+}
+
+void deleteBitMatrix(BitMatrix* matrix)
+{
+	free(matrix->words);
+	free(matrix);
+}
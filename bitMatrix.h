@@ -0,0 +1,35 @@
+#ifndef BIT_MATRIX_H
+#define BIT_MATRIX_H
+
+#include <stdint.h>
+
+#define BIT_WORD 64
+
+typedef enum
+{
+	bitDot = 0, // B is passed transposed, one popcount per bit of C
+	bitFourRussians // B is passed as is, one table lookup per byte of A
+} BitMethod;
+
+// square matrix over GF(2), bit k of a row lives in bit k % 64 of word k / 64
+// the bits past the dimension in the last word of each row are always zero
+typedef struct
+{
+	int dimension;
+	int wordsPerRow;
+	uint64_t* words;
+} BitMatrix;
+
+// all zero
+BitMatrix* createBitMatrix(int dimension);
+
+// one bit per int, any nonzero int is a one
+BitMatrix* packBitMatrix(const int* bits, int dimension);
+
+void unpackBitMatrix(BitMatrix* matrix, int* bits);
+
+BitMatrix* transposeBitMatrix(BitMatrix* matrix);
+
+void deleteBitMatrix(BitMatrix* matrix);
+
+#endif
@@ -1,21 +1,362 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <stdint.h>
+#include <math.h>
+
 #include "scheduler.h"
+#include "blockSum.h"
+
+#ifndef DISABLE_GPU
+#include "mMultGPU.h"
+#endif
+
+typedef void (*SumBlocks)(void* output, int outputWidth, void* blocks, int count, int dimension);
+
+// sum the group's blocks and write them to the output (integers wrap through unsigned)
+#define DEFINE_SUM_BLOCKS(name, type) \
+static void name(void* output, int outputWidth, void* blocks, int count, int dimension) \
+{ \
+	type* outputSpot = (type*)output; \
+	type* writeBack = (type*)blocks; \
+	\
+	for (int i = 0; i < count; i++) \
+	{ \
+		for (int y = 0; y < dimension; y++) \
+			for (int x = 0; x < dimension; x++) \
+			{ \
+				if (i == 0) \
+					outputSpot[y * outputWidth + x] = writeBack[y * dimension + x]; \
+				else \
+					outputSpot[y * outputWidth + x] += \
+					writeBack[i * dimension * dimension + y * dimension + x]; \
+			} \
+	} \
+}
+
+DEFINE_SUM_BLOCKS(sumBlocksInt32, uint32_t)
+DEFINE_SUM_BLOCKS(sumBlocksFloat32, float)
+DEFINE_SUM_BLOCKS(sumBlocksFloat64, double)
+DEFINE_SUM_BLOCKS(sumBlocksInt64, uint64_t)
+
+// fold the group's blocks together with the semiring's plus
+#define DEFINE_REDUCE_BLOCKS(name, type, REDUCE) \
+static void name(void* output, int outputWidth, void* blocks, int count, int dimension) \
+{ \
+	type* outputSpot = (type*)output; \
+	type* writeBack = (type*)blocks; \
+	\
+	for (int y = 0; y < dimension; y++) \
+		for (int x = 0; x < dimension; x++) \
+		{ \
+			type value = writeBack[y * dimension + x]; \
+			\
+			for (int i = 1; i < count; i++) \
+				value = REDUCE(value, writeBack[i * dimension * dimension + y * dimension + x]); \
+			\
+			outputSpot[y * outputWidth + x] = value; \
+		} \
+}
+
+#define REDUCE_MIN(x, y) ((y) < (x) ? (y) : (x))
+#define REDUCE_MAX(x, y) ((y) > (x) ? (y) : (x))
+#define REDUCE_OR(x, y) ((x) | (y))
+
+DEFINE_REDUCE_BLOCKS(minBlocksInt32, int32_t, REDUCE_MIN)
+DEFINE_REDUCE_BLOCKS(minBlocksFloat32, float, REDUCE_MIN)
+DEFINE_REDUCE_BLOCKS(minBlocksFloat64, double, REDUCE_MIN)
+DEFINE_REDUCE_BLOCKS(minBlocksInt64, int64_t, REDUCE_MIN)
+DEFINE_REDUCE_BLOCKS(maxBlocksInt32, int32_t, REDUCE_MAX)
+DEFINE_REDUCE_BLOCKS(maxBlocksFloat32, float, REDUCE_MAX)
+DEFINE_REDUCE_BLOCKS(maxBlocksFloat64, double, REDUCE_MAX)
+DEFINE_REDUCE_BLOCKS(maxBlocksInt64, int64_t, REDUCE_MAX)
+DEFINE_REDUCE_BLOCKS(orBlocksInt32, int32_t, REDUCE_OR)
+
+// int64 partial sums clamped into int32 once the whole group is in
+static void sumBlocksSaturate(void* output, int outputWidth, void* blocks, int count, int dimension)
+{
+	int32_t* outputSpot = (int32_t*)output;
+	uint64_t* writeBack = (uint64_t*)blocks;
+
+	for (int y = 0; y < dimension; y++)
+		for (int x = 0; x < dimension; x++)
+		{
+			uint64_t sum = 0;
+
+			for (int i = 0; i < count; i++)
+				sum += writeBack[i * dimension * dimension + y * dimension + x];
+
+			int64_t value = (int64_t)sum;
+			outputSpot[y * outputWidth + x] = value > INT32_MAX ? INT32_MAX : value < INT32_MIN ? INT32_MIN : (int32_t)value;
+		}
+}
+
+SumBlocks sumBlocks[numElementTypes] =
+{
+	[typeInt32] = sumBlocksInt32,
+	[typeFloat32] = sumBlocksFloat32,
+	[typeFloat64] = sumBlocksFloat64,
+	[typeInt64] = sumBlocksInt64
+};
+
+// residues are summed in 64 bits, a group can never have 2^32 blocks
+static void sumBlocksModular(void* output, int outputWidth, void* blocks, int count, int dimension, uint32_t modulus)
+{
+	uint32_t* outputSpot = (uint32_t*)output;
+	uint32_t* writeBack = (uint32_t*)blocks;
+
+	for (int y = 0; y < dimension; y++)
+		for (int x = 0; x < dimension; x++)
+		{
+			uint64_t sum = 0;
+
+			for (int i = 0; i < count; i++)
+				sum += writeBack[i * dimension * dimension + y * dimension + x];
+
+			outputSpot[y * outputWidth + x] = (uint32_t)(sum % modulus);
+		}
+}
+
+SumBlocks reduceBlocks[numSemirings][numElementTypes] =
+{
+	[semiringMinPlus] =
+	{
+		[typeInt32] = minBlocksInt32,
+		[typeFloat32] = minBlocksFloat32,
+		[typeFloat64] = minBlocksFloat64,
+		[typeInt64] = minBlocksInt64
+	},
+	[semiringMaxPlus] =
+	{
+		[typeInt32] = maxBlocksInt32,
+		[typeFloat32] = maxBlocksFloat32,
+		[typeFloat64] = maxBlocksFloat64,
+		[typeInt64] = maxBlocksInt64
+	},
+	[semiringBoolean] =
+	{
+		[typeInt32] = orBlocksInt32
+	}
+};
+
+typedef void (*SumEpilogue)(void* output, int outputWidth, void* blocks, int count, int dimension, const Epilogue* epilogue, int column, int ops);
+
+// doubles converted back to the output type, integers saturate since an out of range conversion is undefined
+static inline int32_t toInt32(double x)
+{
+	if (x >= (double)INT32_MAX)
+		return INT32_MAX;
+	if (x <= (double)INT32_MIN)
+		return INT32_MIN;
+
+	return x == x ? (int32_t)x : 0;
+}
+
+static inline int64_t toInt64(double x)
+{
+	// 2^63 is the first double past INT64_MAX
+	if (x >= 9223372036854775808.0)
+		return INT64_MAX;
+	if (x <= (double)INT64_MIN)
+		return INT64_MIN;
+
+	return x == x ? (int64_t)x : 0;
+}
+
+static inline float toFloat32(double x)
+{
+	return (float)x;
+}
+
+static inline double toFloat64(double x)
+{
+	return x;
+}
+
+#define TO_VALUE(value, x) _Generic((value), int32_t: toInt32, int64_t: toInt64, float: toFloat32, double: toFloat64)(x)
+
+// round(x * requantScale) + zeroPoint in int8, the product is bounded first so lrintf always has a long to return
+static inline long requantize(float x, const Epilogue* epilogue)
+{
+	float scaled = x * epilogue->requantScale;
+	scaled = scaled < -65536.0f ? -65536.0f : scaled > 65536.0f ? 65536.0f : scaled == scaled ? scaled : 0.0f;
+	long quantized = lrintf(scaled) + epilogue->zeroPoint;
+
+	return quantized < -128 ? -128 : quantized > 127 ? 127 : quantized;
+}
+
+// run one output value through the epilogue, OPS is a constant in the specialized variants so unused steps drop out
+// integer sums and biases wrap through sumType
+#define EPILOGUE_STEPS(sumType, valueType, value, column, epilogue, OPS) \
+	if ((OPS) & epilogueScale) \
+		value = TO_VALUE(value, value * (epilogue)->scale); \
+	if ((OPS) & epilogueBias) \
+		value = (valueType)((sumType)value + ((const sumType*)(epilogue)->bias)[column]); \
+	if ((OPS) & epilogueRelu) \
+		value = value < 0 ? 0 : value; \
+	if ((OPS) & epilogueClamp) \
+		value = value < (epilogue)->lower ? TO_VALUE(value, (epilogue)->lower) : value > (epilogue)->upper ? TO_VALUE(value, (epilogue)->upper) : value; \
+	if ((OPS) & epilogueRequantize) \
+		value = requantize((float)value, epilogue);
+
+// sum the group's blocks and pass each value through the epilogue on its way to the output
+#define DEFINE_SUM_EPILOGUE(name, sumType, valueType, OPS) \
+static void name(void* output, int outputWidth, void* blocks, int count, int dimension, const Epilogue* epilogue, int column, int ops) \
+{ \
+	valueType* outputSpot = (valueType*)output; \
+	sumType* writeBack = (sumType*)blocks; \
+	\
+	for (int y = 0; y < dimension; y++) \
+		for (int x = 0; x < dimension; x++) \
+		{ \
+			sumType sum = writeBack[y * dimension + x]; \
+			\
+			for (int i = 1; i < count; i++) \
+				sum += writeBack[i * dimension * dimension + y * dimension + x]; \
+			\
+			valueType value = (valueType)sum; \
+			EPILOGUE_STEPS(sumType, valueType, value, column + x, epilogue, OPS) \
+			outputSpot[y * outputWidth + x] = value; \
+		} \
+}
+
+// the generic variant and the common combinations compiled on their own
+#define DEFINE_SUM_EPILOGUES(suffix, sumType, valueType) \
+DEFINE_SUM_EPILOGUE(sumEpilogue##suffix, sumType, valueType, ops) \
+DEFINE_SUM_EPILOGUE(sumBias##suffix, sumType, valueType, epilogueBias) \
+DEFINE_SUM_EPILOGUE(sumBiasRelu##suffix, sumType, valueType, epilogueBias | epilogueRelu) \
+DEFINE_SUM_EPILOGUE(sumScaleBiasRelu##suffix, sumType, valueType, epilogueScale | epilogueBias | epilogueRelu)
+
+DEFINE_SUM_EPILOGUES(Int32, uint32_t, int32_t)
+DEFINE_SUM_EPILOGUES(Float32, float, float)
+DEFINE_SUM_EPILOGUES(Float64, double, double)
+DEFINE_SUM_EPILOGUES(Int64, uint64_t, int64_t)
+DEFINE_SUM_EPILOGUE(sumRequantizeInt32, uint32_t, int32_t, epilogueRequantize)
+DEFINE_SUM_EPILOGUE(sumBiasRequantizeInt32, uint32_t, int32_t, epilogueBias | epilogueRequantize)
+DEFINE_SUM_EPILOGUE(sumBiasReluRequantizeInt32, uint32_t, int32_t, epilogueBias | epilogueRelu | epilogueRequantize)
+
+SumEpilogue sumEpilogues[numElementTypes] =
+{
+	[typeInt32] = sumEpilogueInt32,
+	[typeFloat32] = sumEpilogueFloat32,
+	[typeFloat64] = sumEpilogueFloat64,
+	[typeInt64] = sumEpilogueInt64
+};
+
+typedef struct
+{
+	ElementType outType;
+	int ops;
+	SumEpilogue sum;
+} EpilogueVariant;
+
+static const EpilogueVariant epilogueVariants[] =
+{
+	{ typeInt32, epilogueBias, sumBiasInt32 },
+	{ typeInt32, epilogueBias | epilogueRelu, sumBiasReluInt32 },
+	{ typeInt32, epilogueScale | epilogueBias | epilogueRelu, sumScaleBiasReluInt32 },
+	{ typeInt32, epilogueRequantize, sumRequantizeInt32 },
+	{ typeInt32, epilogueBias | epilogueRequantize, sumBiasRequantizeInt32 },
+	{ typeInt32, epilogueBias | epilogueRelu | epilogueRequantize, sumBiasReluRequantizeInt32 },
+	{ typeFloat32, epilogueBias, sumBiasFloat32 },
+	{ typeFloat32, epilogueBias | epilogueRelu, sumBiasReluFloat32 },
+	{ typeFloat32, epilogueScale | epilogueBias | epilogueRelu, sumScaleBiasReluFloat32 },
+	{ typeFloat64, epilogueBias, sumBiasFloat64 },
+	{ typeFloat64, epilogueBias | epilogueRelu, sumBiasReluFloat64 },
+	{ typeFloat64, epilogueScale | epilogueBias | epilogueRelu, sumScaleBiasReluFloat64 },
+	{ typeInt64, epilogueBias, sumBiasInt64 },
+	{ typeInt64, epilogueBias | epilogueRelu, sumBiasReluInt64 },
+	{ typeInt64, epilogueScale | epilogueBias | epilogueRelu, sumScaleBiasReluInt64 }
+};
+
+static SumEpilogue findSumEpilogue(ElementType outType, int ops)
+{
+	for (int i = 0; i < sizeof(epilogueVariants) / sizeof(EpilogueVariant); i++)
+		if (epilogueVariants[i].outType == outType && epilogueVariants[i].ops == ops)
+			return epilogueVariants[i].sum;
+
+	return sumEpilogues[outType];
+}
+
+typedef void (*ApplyEpilogue)(void* output, int outputWidth, int rows, int columns, const Epilogue* epilogue, int column);
+
+// the epilogue over values that are already in the output
+#define DEFINE_APPLY_EPILOGUE(name, sumType, valueType) \
+static void name(void* output, int outputWidth, int rows, int columns, const Epilogue* epilogue, int column) \
+{ \
+	valueType* outputSpot = (valueType*)output; \
+	\
+	for (int y = 0; y < rows; y++) \
+		for (int x = 0; x < columns; x++) \
+		{ \
+			valueType value = outputSpot[(long)y * outputWidth + x]; \
+			EPILOGUE_STEPS(sumType, valueType, value, column + x, epilogue, epilogue->ops) \
+			outputSpot[(long)y * outputWidth + x] = value; \
+		} \
+}
+
+DEFINE_APPLY_EPILOGUE(applyEpilogueInt32, uint32_t, int32_t)
+DEFINE_APPLY_EPILOGUE(applyEpilogueFloat32, float, float)
+DEFINE_APPLY_EPILOGUE(applyEpilogueFloat64, double, double)
+DEFINE_APPLY_EPILOGUE(applyEpilogueInt64, uint64_t, int64_t)
+
+ApplyEpilogue applyEpilogues[numElementTypes] =
+{
+	[typeInt32] = applyEpilogueInt32,
+	[typeFloat32] = applyEpilogueFloat32,
+	[typeFloat64] = applyEpilogueFloat64,
+	[typeInt64] = applyEpilogueInt64
+};
+
+void applyEpilogue(const Epilogue* epilogue, ElementType outType, void* output, int outputWidth, int rows, int columns, int column)
+{
+	applyEpilogues[outType](output, outputWidth, rows, columns, epilogue, column);
+}
+
+typedef void (*AddBlock)(void* output, const void* block, long count);
+
+// add one accumulator block into another of the same type
+#define DEFINE_ADD_BLOCK(name, type) \
+static void name(void* output, const void* block, long count) \
+{ \
+	type* outputSpot = (type*)output; \
+	const type* values = (const type*)block; \
+	\
+	for (long i = 0; i < count; i++) \
+		outputSpot[i] += values[i]; \
+}
+
+DEFINE_ADD_BLOCK(addBlockInt32, uint32_t)
+DEFINE_ADD_BLOCK(addBlockFloat32, float)
+DEFINE_ADD_BLOCK(addBlockFloat64, double)
+DEFINE_ADD_BLOCK(addBlockInt64, uint64_t)
+
+AddBlock addBlocks[numElementTypes] =
+{
+	[typeInt32] = addBlockInt32,
+	[typeFloat32] = addBlockFloat32,
+	[typeFloat64] = addBlockFloat64,
+	[typeInt64] = addBlockInt64
+};
+
+void addBlock(ElementType outType, void* output, const void* block, long count)
+{
+	addBlocks[outType](output, block, count);
+}
 
 void blockSum(SchedPass* sp)
 {
-	int* A = sp->A;
-	int* B = sp->B;
+	void* A = sp->A;
+	void* B = sp->B;
 	pthread_mutex_t* groupLock = sp->groupLock;
 	pthread_cond_t* groupSignal = sp->groupSignal;
 	int* groupProgress = sp->groupProgress;
 
 	int dimension = sp->dimension;
 	int blocksPerGroup = sp->blocksPerGroup;
-	int matrixWidth = blocksPerGroup * dimension;
-	int* writeBack = sp->writeBack;
-	int* outputSpot = sp->outputSpot;
+	int matrixWidth = sp->outputWidth;
+	void* writeBack = sp->writeBack;
+	void* outputSpot = sp->outputSpot;
 
 	// update the group data number
 	// obtain a lock
@@ -44,62 +385,80 @@ void blockSum(SchedPass* sp)
 		exit(-1);
 	}
 
+	// the operand tiles are no longer needed by anyone
+	if (sp->ownsA)
+		free(A);
+
+	if (sp->ownsB)
+		free(B);
+
+	// members are done once they are counted
+	if (sp->localID != 0)
+	{
+		free(sp);
+		return;
+	}
+
 	// only calculate the block sum if this thread is group leader
 	if (sp->localID == 0)
 	{
-		// create the lock
-		pthread_mutex_t waitLock;
-		if (pthread_mutex_init(&(waitLock), NULL) != 0)
+		// wait under the group's own lock so a member finishing between the check and the wait is not missed
+		if (pthread_mutex_lock(groupLock) != 0)
 		{
-			printf("Cannot create mutex\n");
+			printf("Cannot lock.\n");
 			exit(-1);
 		}
-		
-		// obtain a lock
-		if (pthread_mutex_lock(&(waitLock)) != 0)
+
+#ifndef DISABLE_GPU
+		// members batched on the gpu only come back once their batch is read back, so tell the gpu thread
+		if (*groupProgress != blocksPerGroup && sp->leaderWaiting != NULL)
 		{
-			printf("Cannot lock.\n");
-			exit(-1);
+			*sp->leaderWaiting = 1;
+
+			// an idle gpu thread needs a job to notice, a queued one checks when it is done
+			addJob(gpuThreadPool, retireAwaitedGPU, NULL);
 		}
+#endif
 
 		while (*groupProgress != blocksPerGroup)
-			pthread_cond_wait(groupSignal, &(waitLock));
+			pthread_cond_wait(groupSignal, groupLock);
 		
 		// unlock the mutex
-		if (pthread_mutex_unlock(&waitLock) != 0)
+		if (pthread_mutex_unlock(groupLock) != 0)
 		{
 			printf("Cannot unlock.\n");
 			exit(-1);
 		}
 
 		// sum all of the blocks and write to output
-		for (int i = 0; i < blocksPerGroup; i++)
+		if (sp->modulus != NULL)
+			sumBlocksModular(outputSpot, matrixWidth, writeBack, blocksPerGroup, dimension, sp->modulus->modulus);
+		else if (sp->semiring != semiringArithmetic)
+			reduceBlocks[sp->semiring][sp->type](outputSpot, matrixWidth, writeBack, blocksPerGroup, dimension);
+		else if (sp->epilogue != NULL)
 		{
-			for (int y = 0; y < dimension; y++)
-				for (int x = 0; x < dimension; x++)
-				{
-					if (i == 0)
-						outputSpot[y * matrixWidth + x] = writeBack[y * dimension + x];
-					else
-						outputSpot[y * matrixWidth + x] +=
-						writeBack[i * dimension * dimension + y * dimension + x];
-				}
+			ElementType outType = sp->accumulate == accumulateWide ? typeInt64 : elementInfo[sp->type].outType;
+
+			findSumEpilogue(outType, sp->epilogue->ops)(outputSpot, matrixWidth, writeBack, blocksPerGroup, dimension,
+				sp->epilogue, sp->outputColumn, sp->epilogue->ops);
 		}
+		else if (sp->accumulate == accumulateSaturate)
+			sumBlocksSaturate(outputSpot, matrixWidth, writeBack, blocksPerGroup, dimension);
+		else if (sp->accumulate == accumulateWide)
+			sumBlocks[typeInt64](outputSpot, matrixWidth, writeBack, blocksPerGroup, dimension);
+		else
+			sumBlocks[elementInfo[sp->type].outType](outputSpot, matrixWidth, writeBack, blocksPerGroup, dimension);
 
 		// destroy the locks and signals
 		pthread_mutex_lock(groupLock);
 		pthread_mutex_destroy(groupLock);
 		pthread_cond_destroy(groupSignal);
 
-		pthread_mutex_lock(&(waitLock));
-		pthread_mutex_destroy(&(waitLock));
-
 		// remove the data from memory
 		free(groupProgress);
+		free(sp->leaderWaiting);
 		free(groupLock);
 		free(groupSignal);
-		free(A);
-		free(B);
 		free(writeBack);
 
 		// delete the passing structure
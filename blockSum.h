@@ -5,4 +5,10 @@
 
 void blockSum(SchedPass* sp);
 
+// output += block for count accumulator values of outType
+void addBlock(ElementType outType, void* output, const void* block, long count);
+
+// run the epilogue over rows x columns values of outType already in the output, column is the first one's column
+void applyEpilogue(const Epilogue* epilogue, ElementType outType, void* output, int outputWidth, int rows, int columns, int column);
+
 #endif
@@ -0,0 +1,12 @@
+#include "elementType.h"
+
+const ElementInfo elementInfo[numElementTypes] =
+{
+	[typeInt32] = { "int32", 4, 4, 4, typeInt32 },
+	[typeFloat32] = { "float32", 4, 4, 4, typeFloat32 },
+	[typeFloat64] = { "float64", 8, 8, 8, typeFloat64 },
+	[typeInt64] = { "int64", 8, 8, 8, typeInt64 },
+	[typeInt16] = { "int16", 2, 2, 4, typeInt32 },
+	[typeInt8] = { "int8", 1, 1, 4, typeInt32 },
+	[typeUInt8] = { "uint8", 1, 1, 4, typeInt32 }
+};
@@ -0,0 +1,44 @@
+#ifndef ELEMENT_TYPE_H
+#define ELEMENT_TYPE_H
+
+typedef enum
+{
+	typeInt32 = 0,
+	typeFloat32,
+	typeFloat64,
+	typeInt64,
+	typeInt16, // int16 x int16 accumulated in int32
+	typeInt8, // int8 x int8 accumulated in int32
+	typeUInt8, // uint8 x int8 accumulated in int32
+	numElementTypes
+} ElementType;
+
+// how int32 products are accumulated, the wide modes keep exact sums while they fit in int64
+typedef enum
+{
+	accumulateNative = 0, // accumulate and store in the type's own accumulator (int32 wraps)
+	accumulateWide, // accumulate and store in int64
+	accumulateSaturate // accumulate in int64 and store clamped to the int32 range
+} AccumulateMode;
+
+// the (plus, times) pair a product is taken over, the other semirings are only run on the cpu
+typedef enum
+{
+	semiringArithmetic = 0, // (+, *)
+	semiringMinPlus, // (min, +) with +infinity (the type's maximum for integers) as the identity
+	semiringMaxPlus, // (max, +) with -infinity (the type's minimum for integers) as the identity
+	semiringBoolean, // (or, and) on int32 entries that are 0 or 1
+	numSemirings
+} Semiring;
+
+typedef struct
+{
+	const char* name;
+	int sizeA, sizeB; // bytes per operand element
+	int sizeOut; // bytes per accumulated / output element
+	ElementType outType; // type the products are accumulated and stored in
+} ElementInfo;
+
+extern const ElementInfo elementInfo[numElementTypes];
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef EPILOGUE_H
+#define EPILOGUE_H
+
+#include <stdint.h>
+
+// steps applied to each output element as it is written, in this order
+typedef enum
+{
+	epilogueScale = 1, // x * scale, integers are converted back toward zero
+	epilogueBias = 2, // x + bias[column]
+	epilogueRelu = 4, // max(x, 0)
+	epilogueClamp = 8, // x clamped to [lower, upper]
+	epilogueRequantize = 16 // integer outputs only, round(x * requantScale) + zeroPoint clamped to [-128, 127]
+} EpilogueOp;
+
+// requantized values stay in the output's own type and can be narrowed to int8 without loss
+typedef struct
+{
+	int ops; // EpilogueOp flags
+	double scale;
+	const void* bias; // one value of the output type per column, read while the product runs
+	double lower, upper;
+	float requantScale;
+	int32_t zeroPoint;
+} Epilogue;
+
+#endif
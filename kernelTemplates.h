@@ -0,0 +1,572 @@
+#ifndef KERNEL_TEMPLATES_H
+#define KERNEL_TEMPLATES_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <immintrin.h>
+
+#include "modular.h"
+
+// templates for the tile kernels in mMultCPU.c, each computes C = A * B for n x n row-major tiles
+
+// read a packed group of narrow elements as one word
+static inline int32_t loadWord(const void* data)
+{
+	int32_t word;
+	memcpy(&word, data, sizeof(int32_t));
+
+	return word;
+}
+
+// plain c for any element type (the inner loop vectorises for the base isa)
+#define DEFINE_SCALAR_KERNEL(name, typeA, typeB, typeC) \
+static void name(const void* dataA, const void* dataB, void* dataC, int n) \
+{ \
+	const typeA* A = (const typeA*)dataA; \
+	const typeB* B = (const typeB*)dataB; \
+	typeC* C = (typeC*)dataC; \
+	\
+	for (int i = 0; i < n * n; i++) \
+		C[i] = 0; \
+	\
+	for (int i = 0; i < n; i++) \
+		for (int k = 0; k < n; k++) \
+		{ \
+			typeC a = (typeC)A[i * n + k]; \
+			\
+			for (int j = 0; j < n; j++) \
+				C[i * n + j] += a * (typeC)B[k * n + j]; \
+		} \
+}
+
+// register blocked kernel: rows x (vecs * lanes) accumulators stay in registers while k streams through
+// n must be a multiple of rows and vecs * lanes, LOAD may widen the operand into the accumulator lanes
+#define DEFINE_SIMD_KERNEL(name, isa, typeIn, typeOut, vec, lanes, rows, vecs, ZERO, LOAD, STORE, BROADCAST, MULADD) \
+__attribute__((target(isa))) \
+static void name(const void* dataA, const void* dataB, void* dataC, int n) \
+{ \
+	const typeIn* A = (const typeIn*)dataA; \
+	const typeIn* B = (const typeIn*)dataB; \
+	typeOut* C = (typeOut*)dataC; \
+	\
+	for (int i = 0; i < n; i += rows) \
+		for (int j = 0; j < n; j += (lanes) * (vecs)) \
+		{ \
+			vec c[rows][vecs]; \
+			\
+			for (int r = 0; r < rows; r++) \
+				for (int v = 0; v < vecs; v++) \
+					c[r][v] = ZERO(); \
+			\
+			for (int k = 0; k < n; k++) \
+			{ \
+				vec b[vecs]; \
+				\
+				for (int v = 0; v < vecs; v++) \
+					b[v] = LOAD(&B[k * n + j + v * (lanes)]); \
+				\
+				for (int r = 0; r < rows; r++) \
+				{ \
+					vec a = BROADCAST(A[(i + r) * n + k]); \
+					\
+					for (int v = 0; v < vecs; v++) \
+						c[r][v] = MULADD(a, b[v], c[r][v]); \
+				} \
+			} \
+			\
+			for (int r = 0; r < rows; r++) \
+				for (int v = 0; v < vecs; v++) \
+					STORE(&C[(i + r) * n + j + v * (lanes)], c[r][v]); \
+		} \
+}
+
+// narrow integer kernel: every 32 bit word of A holds a group of consecutive k values of one row and
+// every word of B holds the same k values of one column, DOT multiplies the groups and adds them into int32 lanes
+// C is accumulated into so callers can seed it
+#define DEFINE_DOT_KERNEL(name, isa, vec, lanes, rows, LOAD, STORE, BROADCAST, DOT) \
+__attribute__((target(isa))) \
+static void name(const void* A, const int32_t* B, int32_t* C, int n, int words) \
+{ \
+	for (int i = 0; i < n; i += rows) \
+		for (int j = 0; j < n; j += (lanes)) \
+		{ \
+			vec c[rows]; \
+			\
+			for (int r = 0; r < rows; r++) \
+				c[r] = LOAD(&C[(i + r) * n + j]); \
+			\
+			for (int w = 0; w < words; w++) \
+			{ \
+				vec b = LOAD(&B[w * n + j]); \
+				\
+				for (int r = 0; r < rows; r++) \
+					c[r] = DOT(c[r], BROADCAST(loadWord((const char*)A + ((long)(i + r) * words + w) * sizeof(int32_t))), b); \
+			} \
+			\
+			for (int r = 0; r < rows; r++) \
+				STORE(&C[(i + r) * n + j], c[r]); \
+		} \
+}
+
+// semiring kernels reuse DEFINE_SIMD_KERNEL with ZERO giving the identity and MULADD(a, b, c) giving c (+) a (*) b
+
+// plain c for the semirings, COMBINE(c, a, b) folds the product of a and b into c
+#define DEFINE_SEMIRING_SCALAR_KERNEL(name, type, IDENTITY, COMBINE) \
+static void name(const void* dataA, const void* dataB, void* dataC, int n) \
+{ \
+	const type* A = (const type*)dataA; \
+	const type* B = (const type*)dataB; \
+	type* C = (type*)dataC; \
+	\
+	for (int i = 0; i < n * n; i++) \
+		C[i] = IDENTITY; \
+	\
+	for (int i = 0; i < n; i++) \
+		for (int k = 0; k < n; k++) \
+		{ \
+			type a = A[i * n + k]; \
+			\
+			for (int j = 0; j < n; j++) \
+				C[i * n + j] = COMBINE(C[i * n + j], a, B[k * n + j]); \
+		} \
+}
+
+#define MIN_PLUS(c, a, b) ((a) + (b) < (c) ? (a) + (b) : (c))
+#define MAX_PLUS(c, a, b) ((a) + (b) > (c) ? (a) + (b) : (c))
+#define OR_AND(c, a, b) ((c) | ((a) & (b)))
+
+// modular kernels take int32 residues below the modulus and write C = A * B mod modulus
+// products are summed in 64 bits for lazy steps at a time, then each segment is folded in with a montgomery reduction
+
+#define DEFINE_MODULAR_SCALAR_KERNEL(name) \
+static void name(const void* dataA, const void* dataB, void* dataC, int n, const Modulus* modulus) \
+{ \
+	const uint32_t* A = (const uint32_t*)dataA; \
+	const uint32_t* B = (const uint32_t*)dataB; \
+	uint32_t* C = (uint32_t*)dataC; \
+	uint64_t segment[n], total[n]; \
+	\
+	for (int i = 0; i < n; i++) \
+	{ \
+		for (int j = 0; j < n; j++) \
+			total[j] = 0; \
+		\
+		for (int k0 = 0; k0 < n; k0 += modulus->lazy) \
+		{ \
+			int kEnd = n - k0 < modulus->lazy ? n : k0 + modulus->lazy; \
+			\
+			for (int j = 0; j < n; j++) \
+				segment[j] = 0; \
+			\
+			for (int k = k0; k < kEnd; k++) \
+			{ \
+				uint64_t a = A[i * n + k]; \
+				\
+				for (int j = 0; j < n; j++) \
+					segment[j] += a * B[k * n + j]; \
+			} \
+			\
+			for (int j = 0; j < n; j++) \
+				total[j] += montgomeryReduce(segment[j], modulus->modulus, modulus->inverse); \
+		} \
+		\
+		for (int j = 0; j < n; j++) \
+			C[i * n + j] = finishModular(total[j], modulus); \
+	} \
+}
+
+// rows x (vecs * lanes) segment and total sums stay in registers, LOAD widens B into 64 bit lanes
+// n must be a multiple of rows and vecs * lanes
+#define DEFINE_MODULAR_SIMD_KERNEL(name, isa, vec, lanes, rows, vecs, ZERO, LOAD, STORE, SET1, MUL, ADD, REDUCE) \
+__attribute__((target(isa))) \
+static void name(const void* dataA, const void* dataB, void* dataC, int n, const Modulus* modulus) \
+{ \
+	const uint32_t* A = (const uint32_t*)dataA; \
+	const uint32_t* B = (const uint32_t*)dataB; \
+	uint32_t* C = (uint32_t*)dataC; \
+	vec p = SET1(modulus->modulus); \
+	vec inverse = SET1(modulus->inverse); \
+	\
+	for (int i = 0; i < n; i += (rows)) \
+		for (int j = 0; j < n; j += (lanes) * (vecs)) \
+		{ \
+			vec total[rows][vecs]; \
+			\
+			for (int r = 0; r < (rows); r++) \
+				for (int v = 0; v < (vecs); v++) \
+					total[r][v] = ZERO(); \
+			\
+			for (int k0 = 0; k0 < n; k0 += modulus->lazy) \
+			{ \
+				int kEnd = n - k0 < modulus->lazy ? n : k0 + modulus->lazy; \
+				vec c[rows][vecs]; \
+				\
+				for (int r = 0; r < (rows); r++) \
+					for (int v = 0; v < (vecs); v++) \
+						c[r][v] = ZERO(); \
+				\
+				for (int k = k0; k < kEnd; k++) \
+				{ \
+					vec b[vecs]; \
+					\
+					for (int v = 0; v < (vecs); v++) \
+						b[v] = LOAD(&B[k * n + j + v * (lanes)]); \
+					\
+					for (int r = 0; r < (rows); r++) \
+					{ \
+						vec a = SET1(A[(i + r) * n + k]); \
+						\
+						for (int v = 0; v < (vecs); v++) \
+							c[r][v] = ADD(c[r][v], MUL(a, b[v])); \
+					} \
+				} \
+				\
+				for (int r = 0; r < (rows); r++) \
+					for (int v = 0; v < (vecs); v++) \
+						total[r][v] = ADD(total[r][v], REDUCE(c[r][v], p, inverse)); \
+			} \
+			\
+			for (int r = 0; r < (rows); r++) \
+				for (int v = 0; v < (vecs); v++) \
+				{ \
+					uint64_t lane[lanes]; \
+					STORE(lane, total[r][v]); \
+					\
+					for (int l = 0; l < (lanes); l++) \
+						C[(i + r) * n + j + v * (lanes) + l] = finishModular(lane[l], modulus); \
+				} \
+		} \
+}
+
+// sparse kernels compute block rows of C = A * B for a compressed A and a row-major n x n B
+// each of the count entries has a column (in blocks) and a rows x rows block of values, rows is 1 for CSR
+
+// plain c, the update of each C row vectorises for the base isa
+#define DEFINE_SPARSE_SCALAR_KERNEL(name, type, typeAcc, rows) \
+static void name(const void* dataValues, const int* cols, long count, const void* dataB, void* dataC, int n) \
+{ \
+	const type* values = (const type*)dataValues; \
+	const type* B = (const type*)dataB; \
+	typeAcc* C = (typeAcc*)dataC; \
+	\
+	for (long i = 0; i < (long)(rows) * n; i++) \
+		C[i] = 0; \
+	\
+	for (long e = 0; e < count; e++) \
+		for (int r = 0; r < (rows); r++) \
+			for (int t = 0; t < (rows); t++) \
+			{ \
+				typeAcc a = (typeAcc)values[(e * (rows) + r) * (rows) + t]; \
+				const type* row = &B[((long)cols[e] * (rows) + t) * n]; \
+				\
+				for (int j = 0; j < n; j++) \
+					C[(long)r * n + j] += a * (typeAcc)row[j]; \
+			} \
+}
+
+// a rows x (vecs * lanes) strip of C stays in registers while the entries of the block row stream through
+#define DEFINE_SPARSE_SIMD_KERNEL(name, isa, type, typeAcc, vec, lanes, rows, vecs, ZERO, LOAD, STORE, BROADCAST, MULADD) \
+__attribute__((target(isa))) \
+static void name(const void* dataValues, const int* cols, long count, const void* dataB, void* dataC, int n) \
+{ \
+	const type* values = (const type*)dataValues; \
+	const type* B = (const type*)dataB; \
+	typeAcc* C = (typeAcc*)dataC; \
+	int j = 0; \
+	\
+	for (; j + (lanes) * (vecs) <= n; j += (lanes) * (vecs)) \
+	{ \
+		vec c[rows][vecs]; \
+		\
+		for (int r = 0; r < (rows); r++) \
+			for (int v = 0; v < (vecs); v++) \
+				c[r][v] = ZERO(); \
+		\
+		for (long e = 0; e < count; e++) \
+			for (int t = 0; t < (rows); t++) \
+			{ \
+				const type* row = &B[((long)cols[e] * (rows) + t) * n + j]; \
+				vec b[vecs]; \
+				\
+				for (int v = 0; v < (vecs); v++) \
+					b[v] = LOAD(&row[v * (lanes)]); \
+				\
+				for (int r = 0; r < (rows); r++) \
+				{ \
+					vec a = BROADCAST(values[(e * (rows) + r) * (rows) + t]); \
+					\
+					for (int v = 0; v < (vecs); v++) \
+						c[r][v] = MULADD(a, b[v], c[r][v]); \
+				} \
+			} \
+		\
+		for (int r = 0; r < (rows); r++) \
+			for (int v = 0; v < (vecs); v++) \
+				STORE(&C[(long)r * n + j + v * (lanes)], c[r][v]); \
+	} \
+	\
+	for (; j < n; j++) \
+		for (int r = 0; r < (rows); r++) \
+		{ \
+			typeAcc sum = 0; \
+			\
+			for (long e = 0; e < count; e++) \
+				for (int t = 0; t < (rows); t++) \
+					sum += (typeAcc)values[(e * (rows) + r) * (rows) + t] * (typeAcc)B[((long)cols[e] * (rows) + t) * n + j]; \
+			\
+			C[(long)r * n + j] = sum; \
+		} \
+}
+
+// skinny kernels compute rows [beginRow, endRow) of C = A * B where B has only a few columns
+// B is passed transposed (columns x n) so every output is a dot product of two contiguous rows
+
+// plain c, the dot products vectorise for the base isa when the accumulator is an integer
+#define DEFINE_SKINNY_SCALAR_KERNEL(name, typeA, typeB, typeAcc) \
+static void name(const void* dataA, const void* dataB, void* dataC, int n, int columns, int beginRow, int endRow) \
+{ \
+	const typeA* A = (const typeA*)dataA; \
+	const typeB* B = (const typeB*)dataB; \
+	typeAcc* C = (typeAcc*)dataC; \
+	\
+	for (int i = beginRow; i < endRow; i++) \
+		for (int j = 0; j < columns; j++) \
+		{ \
+			typeAcc sum = 0; \
+			\
+			for (int k = 0; k < n; k++) \
+				sum += (typeAcc)A[(long)i * n + k] * (typeAcc)B[(long)j * n + k]; \
+			\
+			C[(long)i * columns + j] = sum; \
+		} \
+}
+
+// rows x cols dot products share their loads while k streams through, the lanes are summed at the end
+// rows and columns past the edge repeat the last one so the loops keep a fixed trip count, their sums are dropped
+#define DEFINE_SKINNY_SIMD_KERNEL(name, isa, type, typeAcc, vec, lanes, rows, cols, ZERO, LOAD, STORE, MULADD) \
+__attribute__((target(isa))) \
+static void name(const void* dataA, const void* dataB, void* dataC, int n, int columns, int beginRow, int endRow) \
+{ \
+	const type* A = (const type*)dataA; \
+	const type* B = (const type*)dataB; \
+	typeAcc* C = (typeAcc*)dataC; \
+	int tail = n - n % (lanes); \
+	\
+	for (int i = beginRow; i < endRow; i += (rows)) \
+		for (int j = 0; j < columns; j += (cols)) \
+		{ \
+			const type* a[rows]; \
+			const type* b[cols]; \
+			vec c[rows][cols]; \
+			\
+			for (int r = 0; r < (rows); r++) \
+				a[r] = &A[(long)(i + r < endRow ? i + r : endRow - 1) * n]; \
+			\
+			for (int v = 0; v < (cols); v++) \
+				b[v] = &B[(long)(j + v < columns ? j + v : columns - 1) * n]; \
+			\
+			for (int r = 0; r < (rows); r++) \
+				for (int v = 0; v < (cols); v++) \
+					c[r][v] = ZERO(); \
+			\
+			for (int k = 0; k < tail; k += (lanes)) \
+			{ \
+				vec bk[cols]; \
+				\
+				for (int v = 0; v < (cols); v++) \
+					bk[v] = LOAD(&b[v][k]); \
+				\
+				for (int r = 0; r < (rows); r++) \
+				{ \
+					vec ak = LOAD(&a[r][k]); \
+					\
+					for (int v = 0; v < (cols); v++) \
+						c[r][v] = MULADD(ak, bk[v], c[r][v]); \
+				} \
+			} \
+			\
+			for (int r = 0; r < (rows) && i + r < endRow; r++) \
+				for (int v = 0; v < (cols) && j + v < columns; v++) \
+				{ \
+					typeAcc lane[lanes]; \
+					typeAcc sum = 0; \
+					\
+					STORE(lane, c[r][v]); \
+					\
+					for (int l = 0; l < (lanes); l++) \
+						sum += lane[l]; \
+					\
+					for (int k = tail; k < n; k++) \
+						sum += (typeAcc)a[r][k] * (typeAcc)b[v][k]; \
+					\
+					C[(long)(i + r) * columns + j + v] = sum; \
+				} \
+		} \
+}
+
+// low rank kernels add rows [beginRow, endRow) of X * Y to C, X has inner columns and Y is inner x columns
+// every row of Y is scaled and streamed into a row of C, so the loops vectorise for the isa without a tile
+#define DEFINE_RANK_KERNEL(name, type, attributes) \
+attributes \
+static void name(const void* dataX, const void* dataY, void* dataC, int inner, int columns, int beginRow, int endRow) \
+{ \
+	const type* X = (const type*)dataX; \
+	const type* Y = (const type*)dataY; \
+	type* C = (type*)dataC; \
+	\
+	for (int i = beginRow; i < endRow; i++) \
+		for (int k = 0; k < inner; k++) \
+		{ \
+			type x = X[(long)i * inner + k]; \
+			type* row = &C[(long)i * columns]; \
+			const type* source = &Y[(long)k * columns]; \
+			\
+			for (int j = 0; j < columns; j++) \
+				row[j] += x * source[j]; \
+		} \
+}
+
+// GF(2) kernels compute rows [beginRow, endRow) of C = A * B for rows packed into uint64_t words
+
+// Method of Four Russians: the 256 sums of every 8 rows of B are tabled once, then each row of A
+// picks one table row per byte instead of one row of B per bit, the word loops vectorise for the isa
+#define DEFINE_FOUR_RUSSIANS_KERNEL(name, attributes) \
+attributes \
+static void name(const uint64_t* A, const uint64_t* B, uint64_t* C, int n, int words, int beginRow, int endRow, uint64_t* table) \
+{ \
+	for (long i = (long)beginRow * words; i < (long)endRow * words; i++) \
+		C[i] = 0; \
+	\
+	for (int k = 0; k < n; k += 8) \
+	{ \
+		for (int w = 0; w < words; w++) \
+			table[w] = 0; \
+		\
+		/* every entry adds its lowest row to the entry without it, rows past n are zero */ \
+		for (int entry = 1; entry < 256; entry++) \
+		{ \
+			int bit = __builtin_ctz(entry); \
+			const uint64_t* previous = &table[(long)(entry & (entry - 1)) * words]; \
+			uint64_t* current = &table[(long)entry * words]; \
+			\
+			if (k + bit < n) \
+			{ \
+				const uint64_t* row = &B[(long)(k + bit) * words]; \
+				\
+				for (int w = 0; w < words; w++) \
+					current[w] = previous[w] ^ row[w]; \
+			} \
+			else \
+				for (int w = 0; w < words; w++) \
+					current[w] = previous[w]; \
+		} \
+		\
+		for (int i = beginRow; i < endRow; i++) \
+		{ \
+			int entry = (A[(long)i * words + k / 64] >> (k % 64)) & 0xFF; \
+			\
+			if (entry == 0) \
+				continue; \
+			\
+			const uint64_t* sum = &table[(long)entry * words]; \
+			uint64_t* row = &C[(long)i * words]; \
+			\
+			for (int w = 0; w < words; w++) \
+				row[w] ^= sum[w]; \
+		} \
+	} \
+}
+
+// 256 bit operations
+#define ZERO_SI256() _mm256_setzero_si256()
+#define LOAD_SI256(p) _mm256_loadu_si256((const __m256i*)(p))
+#define STORE_SI256(p, v) _mm256_storeu_si256((__m256i*)(p), v)
+#define MULADD_EPI32_256(a, b, c) _mm256_add_epi32(c, _mm256_mullo_epi32(a, b))
+#define MULADD_EPI64_256(a, b, c) _mm256_add_epi64(c, mullo64(a, b))
+#define LOAD_WIDE_EPI32_256(p) _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*)(p)))
+#define MULADD_WIDE_EPI32_256(a, b, c) _mm256_add_epi64(c, _mm256_mul_epi32(a, b))
+#define FMADD_PS_256(a, b, c) _mm256_fmadd_ps(a, b, c)
+#define FMADD_PD_256(a, b, c) _mm256_fmadd_pd(a, b, c)
+#define DOT_PAIR_256(c, a, b) _mm256_add_epi32(c, _mm256_madd_epi16(a, b))
+#define DOT_PAIR_VNNI_256(c, a, b) _mm256_dpwssd_avx_epi32(c, a, b)
+#define DOT_QUAD_VNNI_256(c, a, b) _mm256_dpbusd_avx_epi32(c, a, b)
+#define MAX_EPI32_256() _mm256_set1_epi32(INT32_MAX)
+#define MIN_EPI32_256() _mm256_set1_epi32(INT32_MIN)
+#define MAX_EPI64_256() _mm256_set1_epi64x(INT64_MAX)
+#define MIN_EPI64_256() _mm256_set1_epi64x(INT64_MIN)
+#define INFINITY_PS_256() _mm256_set1_ps(INFINITY)
+#define NEG_INFINITY_PS_256() _mm256_set1_ps(-INFINITY)
+#define INFINITY_PD_256() _mm256_set1_pd(INFINITY)
+#define NEG_INFINITY_PD_256() _mm256_set1_pd(-INFINITY)
+#define MIN_PLUS_EPI32_256(a, b, c) _mm256_min_epi32(c, _mm256_add_epi32(a, b))
+#define MAX_PLUS_EPI32_256(a, b, c) _mm256_max_epi32(c, _mm256_add_epi32(a, b))
+#define MIN_PLUS_EPI64_256(a, b, c) min64(c, _mm256_add_epi64(a, b))
+#define MAX_PLUS_EPI64_256(a, b, c) max64(c, _mm256_add_epi64(a, b))
+#define MIN_PLUS_PS_256(a, b, c) _mm256_min_ps(c, _mm256_add_ps(a, b))
+#define MAX_PLUS_PS_256(a, b, c) _mm256_max_ps(c, _mm256_add_ps(a, b))
+#define MIN_PLUS_PD_256(a, b, c) _mm256_min_pd(c, _mm256_add_pd(a, b))
+#define MAX_PLUS_PD_256(a, b, c) _mm256_max_pd(c, _mm256_add_pd(a, b))
+#define OR_AND_256(a, b, c) _mm256_or_si256(c, _mm256_and_si256(a, b))
+#define LOAD_WIDE_EPU32_256(p) _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i*)(p)))
+#define MONTGOMERY_EPI64_256(x, p, inverse) \
+	_mm256_srli_epi64(_mm256_add_epi64(x, _mm256_mul_epu32(_mm256_mul_epu32(x, inverse), p)), 32)
+
+// 512 bit operations
+#define ZERO_SI512() _mm512_setzero_si512()
+#define LOAD_SI512(p) _mm512_loadu_si512((const void*)(p))
+#define STORE_SI512(p, v) _mm512_storeu_si512((void*)(p), v)
+#define MULADD_EPI32_512(a, b, c) _mm512_add_epi32(c, _mm512_mullo_epi32(a, b))
+#define MULADD_EPI64_512(a, b, c) _mm512_add_epi64(c, _mm512_mullo_epi64(a, b))
+#define LOAD_WIDE_EPI32_512(p) _mm512_cvtepi32_epi64(_mm256_loadu_si256((const __m256i*)(p)))
+#define MULADD_WIDE_EPI32_512(a, b, c) _mm512_add_epi64(c, _mm512_mul_epi32(a, b))
+#define FMADD_PS_512(a, b, c) _mm512_fmadd_ps(a, b, c)
+#define FMADD_PD_512(a, b, c) _mm512_fmadd_pd(a, b, c)
+#define DOT_PAIR_VNNI_512(c, a, b) _mm512_dpwssd_epi32(c, a, b)
+#define DOT_QUAD_VNNI_512(c, a, b) _mm512_dpbusd_epi32(c, a, b)
+#define MAX_EPI32_512() _mm512_set1_epi32(INT32_MAX)
+#define MIN_EPI32_512() _mm512_set1_epi32(INT32_MIN)
+#define MAX_EPI64_512() _mm512_set1_epi64(INT64_MAX)
+#define MIN_EPI64_512() _mm512_set1_epi64(INT64_MIN)
+#define INFINITY_PS_512() _mm512_set1_ps(INFINITY)
+#define NEG_INFINITY_PS_512() _mm512_set1_ps(-INFINITY)
+#define INFINITY_PD_512() _mm512_set1_pd(INFINITY)
+#define NEG_INFINITY_PD_512() _mm512_set1_pd(-INFINITY)
+#define MIN_PLUS_EPI32_512(a, b, c) _mm512_min_epi32(c, _mm512_add_epi32(a, b))
+#define MAX_PLUS_EPI32_512(a, b, c) _mm512_max_epi32(c, _mm512_add_epi32(a, b))
+#define MIN_PLUS_EPI64_512(a, b, c) _mm512_min_epi64(c, _mm512_add_epi64(a, b))
+#define MAX_PLUS_EPI64_512(a, b, c) _mm512_max_epi64(c, _mm512_add_epi64(a, b))
+#define MIN_PLUS_PS_512(a, b, c) _mm512_min_ps(c, _mm512_add_ps(a, b))
+#define MAX_PLUS_PS_512(a, b, c) _mm512_max_ps(c, _mm512_add_ps(a, b))
+#define MIN_PLUS_PD_512(a, b, c) _mm512_min_pd(c, _mm512_add_pd(a, b))
+#define MAX_PLUS_PD_512(a, b, c) _mm512_max_pd(c, _mm512_add_pd(a, b))
+#define OR_AND_512(a, b, c) _mm512_or_si512(c, _mm512_and_si512(a, b))
+#define LOAD_WIDE_EPU32_512(p) _mm512_cvtepu32_epi64(_mm256_loadu_si256((const __m256i*)(p)))
+#define MONTGOMERY_EPI64_512(x, p, inverse) \
+	_mm512_srli_epi64(_mm512_add_epi64(x, _mm512_mul_epu32(_mm512_mul_epu32(x, inverse), p)), 32)
+
+// avx2 has no 64 bit low multiply so build it from 32 bit halves
+__attribute__((target("avx2")))
+static inline __m256i mullo64(__m256i a, __m256i b)
+{
+	__m256i low = _mm256_mul_epu32(a, b);
+	__m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+		_mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+
+	return _mm256_add_epi64(low, _mm256_slli_epi64(cross, 32));
+}
+
+// nor a 64 bit min or max, so pick lanes with a compare
+__attribute__((target("avx2")))
+static inline __m256i min64(__m256i a, __m256i b)
+{
+	return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(a, b));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i max64(__m256i a, __m256i b)
+{
+	return _mm256_blendv_epi8(b, a, _mm256_cmpgt_epi64(a, b));
+}
+
+#endif
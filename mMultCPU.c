@@ -1,11 +1,736 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 
 #include "scheduler.h"
 #include "blockSum.h"
+#include "mMultCPU.h"
+#include "kernelTemplates.h"
 
 #define NO_STRASSEN
 
+typedef enum
+{
+	isaScalar = 0,
+	isaAVX2,
+	isaAVXVNNI,
+	isaAVX512
+} ISALevel;
+
+typedef void (*DotKernel)(const void* A, const int32_t* B, int32_t* C, int n, int words);
+
+TileKernel tileKernels[numElementTypes];
+
+// null while the tile kernel reads B as stored
+TilePacker tilePackers[numElementTypes];
+
+// per thread scratch of the narrow tile kernels
+pthread_key_t scratchKey;
+
+// int32 operands accumulated in int64
+TileKernel wideTileKernel;
+
+SparseKernel sparseKernels[2][numElementTypes];
+
+SkinnyKernel skinnyKernels[numElementTypes];
+
+BitKernel bitKernels[2];
+
+// null where the semiring is not supported for the type, the arithmetic row is unused
+TileKernel semiringKernels[numSemirings][numElementTypes];
+
+ModularKernel modularKernel;
+
+// only the types that accumulate in their own type
+RankKernel rankKernels[numElementTypes];
+
+pthread_once_t selectKernelsOnce = PTHREAD_ONCE_INIT;
+
+// integer accumulators are unsigned so wrapping is defined
+DEFINE_SCALAR_KERNEL(multiplyInt32Scalar, int32_t, int32_t, uint32_t)
+DEFINE_SCALAR_KERNEL(multiplyFloat32Scalar, float, float, float)
+DEFINE_SCALAR_KERNEL(multiplyFloat64Scalar, double, double, double)
+DEFINE_SCALAR_KERNEL(multiplyInt64Scalar, int64_t, int64_t, uint64_t)
+DEFINE_SCALAR_KERNEL(multiplyInt16Scalar, int16_t, int16_t, uint32_t)
+DEFINE_SCALAR_KERNEL(multiplyInt8Scalar, int8_t, int8_t, uint32_t)
+DEFINE_SCALAR_KERNEL(multiplyUInt8Scalar, uint8_t, int8_t, uint32_t)
+DEFINE_SCALAR_KERNEL(multiplyInt32WideScalar, int32_t, int32_t, uint64_t)
+
+DEFINE_SIMD_KERNEL(multiplyInt32AVX2, "avx2", int32_t, int32_t, __m256i, 8, 4, 2,
+	ZERO_SI256, LOAD_SI256, STORE_SI256, _mm256_set1_epi32, MULADD_EPI32_256)
+DEFINE_SIMD_KERNEL(multiplyFloat32AVX2, "avx2,fma", float, float, __m256, 8, 4, 2,
+	_mm256_setzero_ps, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_set1_ps, FMADD_PS_256)
+DEFINE_SIMD_KERNEL(multiplyFloat64AVX2, "avx2,fma", double, double, __m256d, 4, 4, 2,
+	_mm256_setzero_pd, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_set1_pd, FMADD_PD_256)
+DEFINE_SIMD_KERNEL(multiplyInt64AVX2, "avx2", int64_t, int64_t, __m256i, 4, 4, 2,
+	ZERO_SI256, LOAD_SI256, STORE_SI256, _mm256_set1_epi64x, MULADD_EPI64_256)
+DEFINE_SIMD_KERNEL(multiplyInt32WideAVX2, "avx2", int32_t, int64_t, __m256i, 4, 4, 2,
+	ZERO_SI256, LOAD_WIDE_EPI32_256, STORE_SI256, _mm256_set1_epi64x, MULADD_WIDE_EPI32_256)
+
+DEFINE_SIMD_KERNEL(multiplyInt32AVX512, "avx512f", int32_t, int32_t, __m512i, 16, 8, 1,
+	ZERO_SI512, LOAD_SI512, STORE_SI512, _mm512_set1_epi32, MULADD_EPI32_512)
+DEFINE_SIMD_KERNEL(multiplyFloat32AVX512, "avx512f", float, float, __m512, 16, 8, 1,
+	_mm512_setzero_ps, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_set1_ps, FMADD_PS_512)
+DEFINE_SIMD_KERNEL(multiplyFloat64AVX512, "avx512f", double, double, __m512d, 8, 8, 1,
+	_mm512_setzero_pd, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_set1_pd, FMADD_PD_512)
+DEFINE_SIMD_KERNEL(multiplyInt64AVX512, "avx512f,avx512dq", int64_t, int64_t, __m512i, 8, 8, 1,
+	ZERO_SI512, LOAD_SI512, STORE_SI512, _mm512_set1_epi64, MULADD_EPI64_512)
+DEFINE_SIMD_KERNEL(multiplyInt32WideAVX512, "avx512f", int32_t, int64_t, __m512i, 8, 8, 1,
+	ZERO_SI512, LOAD_WIDE_EPI32_512, STORE_SI512, _mm512_set1_epi64, MULADD_WIDE_EPI32_512)
+
+DEFINE_DOT_KERNEL(dotPairsAVX2, "avx2", __m256i, 8, 8,
+	LOAD_SI256, STORE_SI256, _mm256_set1_epi32, DOT_PAIR_256)
+DEFINE_DOT_KERNEL(dotPairsAVXVNNI, "avx2,avxvnni", __m256i, 8, 8,
+	LOAD_SI256, STORE_SI256, _mm256_set1_epi32, DOT_PAIR_VNNI_256)
+DEFINE_DOT_KERNEL(dotQuadsAVXVNNI, "avx2,avxvnni", __m256i, 8, 8,
+	LOAD_SI256, STORE_SI256, _mm256_set1_epi32, DOT_QUAD_VNNI_256)
+DEFINE_DOT_KERNEL(dotPairsAVX512VNNI, "avx512f,avx512vnni", __m512i, 16, 8,
+	LOAD_SI512, STORE_SI512, _mm512_set1_epi32, DOT_PAIR_VNNI_512)
+DEFINE_DOT_KERNEL(dotQuadsAVX512VNNI, "avx512f,avx512vnni", __m512i, 16, 8,
+	LOAD_SI512, STORE_SI512, _mm512_set1_epi32, DOT_QUAD_VNNI_512)
+
+DEFINE_SPARSE_SCALAR_KERNEL(sparseRowInt32Scalar, int32_t, uint32_t, 1)
+DEFINE_SPARSE_SCALAR_KERNEL(sparseRowFloat32Scalar, float, float, 1)
+DEFINE_SPARSE_SCALAR_KERNEL(sparseRowFloat64Scalar, double, double, 1)
+DEFINE_SPARSE_SCALAR_KERNEL(sparseRowInt64Scalar, int64_t, uint64_t, 1)
+DEFINE_SPARSE_SCALAR_KERNEL(sparseBlockInt32Scalar, int32_t, uint32_t, SPARSE_BLOCK)
+DEFINE_SPARSE_SCALAR_KERNEL(sparseBlockFloat32Scalar, float, float, SPARSE_BLOCK)
+DEFINE_SPARSE_SCALAR_KERNEL(sparseBlockFloat64Scalar, double, double, SPARSE_BLOCK)
+DEFINE_SPARSE_SCALAR_KERNEL(sparseBlockInt64Scalar, int64_t, uint64_t, SPARSE_BLOCK)
+
+DEFINE_SPARSE_SIMD_KERNEL(sparseRowInt32AVX2, "avx2", int32_t, uint32_t, __m256i, 8, 1, 4,
+	ZERO_SI256, LOAD_SI256, STORE_SI256, _mm256_set1_epi32, MULADD_EPI32_256)
+DEFINE_SPARSE_SIMD_KERNEL(sparseRowFloat32AVX2, "avx2,fma", float, float, __m256, 8, 1, 4,
+	_mm256_setzero_ps, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_set1_ps, FMADD_PS_256)
+DEFINE_SPARSE_SIMD_KERNEL(sparseRowFloat64AVX2, "avx2,fma", double, double, __m256d, 4, 1, 4,
+	_mm256_setzero_pd, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_set1_pd, FMADD_PD_256)
+DEFINE_SPARSE_SIMD_KERNEL(sparseRowInt64AVX2, "avx2", int64_t, uint64_t, __m256i, 4, 1, 4,
+	ZERO_SI256, LOAD_SI256, STORE_SI256, _mm256_set1_epi64x, MULADD_EPI64_256)
+DEFINE_SPARSE_SIMD_KERNEL(sparseBlockInt32AVX2, "avx2", int32_t, uint32_t, __m256i, 8, SPARSE_BLOCK, 2,
+	ZERO_SI256, LOAD_SI256, STORE_SI256, _mm256_set1_epi32, MULADD_EPI32_256)
+DEFINE_SPARSE_SIMD_KERNEL(sparseBlockFloat32AVX2, "avx2,fma", float, float, __m256, 8, SPARSE_BLOCK, 2,
+	_mm256_setzero_ps, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_set1_ps, FMADD_PS_256)
+DEFINE_SPARSE_SIMD_KERNEL(sparseBlockFloat64AVX2, "avx2,fma", double, double, __m256d, 4, SPARSE_BLOCK, 2,
+	_mm256_setzero_pd, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_set1_pd, FMADD_PD_256)
+DEFINE_SPARSE_SIMD_KERNEL(sparseBlockInt64AVX2, "avx2", int64_t, uint64_t, __m256i, 4, SPARSE_BLOCK, 2,
+	ZERO_SI256, LOAD_SI256, STORE_SI256, _mm256_set1_epi64x, MULADD_EPI64_256)
+
+DEFINE_SPARSE_SIMD_KERNEL(sparseRowInt32AVX512, "avx512f", int32_t, uint32_t, __m512i, 16, 1, 4,
+	ZERO_SI512, LOAD_SI512, STORE_SI512, _mm512_set1_epi32, MULADD_EPI32_512)
+DEFINE_SPARSE_SIMD_KERNEL(sparseRowFloat32AVX512, "avx512f", float, float, __m512, 16, 1, 4,
+	_mm512_setzero_ps, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_set1_ps, FMADD_PS_512)
+DEFINE_SPARSE_SIMD_KERNEL(sparseRowFloat64AVX512, "avx512f", double, double, __m512d, 8, 1, 4,
+	_mm512_setzero_pd, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_set1_pd, FMADD_PD_512)
+DEFINE_SPARSE_SIMD_KERNEL(sparseRowInt64AVX512, "avx512f,avx512dq", int64_t, uint64_t, __m512i, 8, 1, 4,
+	ZERO_SI512, LOAD_SI512, STORE_SI512, _mm512_set1_epi64, MULADD_EPI64_512)
+DEFINE_SPARSE_SIMD_KERNEL(sparseBlockInt32AVX512, "avx512f", int32_t, uint32_t, __m512i, 16, SPARSE_BLOCK, 2,
+	ZERO_SI512, LOAD_SI512, STORE_SI512, _mm512_set1_epi32, MULADD_EPI32_512)
+DEFINE_SPARSE_SIMD_KERNEL(sparseBlockFloat32AVX512, "avx512f", float, float, __m512, 16, SPARSE_BLOCK, 2,
+	_mm512_setzero_ps, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_set1_ps, FMADD_PS_512)
+DEFINE_SPARSE_SIMD_KERNEL(sparseBlockFloat64AVX512, "avx512f", double, double, __m512d, 8, SPARSE_BLOCK, 2,
+	_mm512_setzero_pd, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_set1_pd, FMADD_PD_512)
+DEFINE_SPARSE_SIMD_KERNEL(sparseBlockInt64AVX512, "avx512f,avx512dq", int64_t, uint64_t, __m512i, 8, SPARSE_BLOCK, 2,
+	ZERO_SI512, LOAD_SI512, STORE_SI512, _mm512_set1_epi64, MULADD_EPI64_512)
+
+DEFINE_SKINNY_SCALAR_KERNEL(skinnyInt32Scalar, int32_t, int32_t, uint32_t)
+DEFINE_SKINNY_SCALAR_KERNEL(skinnyFloat32Scalar, float, float, float)
+DEFINE_SKINNY_SCALAR_KERNEL(skinnyFloat64Scalar, double, double, double)
+DEFINE_SKINNY_SCALAR_KERNEL(skinnyInt64Scalar, int64_t, int64_t, uint64_t)
+DEFINE_SKINNY_SCALAR_KERNEL(skinnyInt16Scalar, int16_t, int16_t, uint32_t)
+DEFINE_SKINNY_SCALAR_KERNEL(skinnyInt8Scalar, int8_t, int8_t, uint32_t)
+DEFINE_SKINNY_SCALAR_KERNEL(skinnyUInt8Scalar, uint8_t, int8_t, uint32_t)
+
+DEFINE_SKINNY_SIMD_KERNEL(skinnyInt32AVX2, "avx2", int32_t, uint32_t, __m256i, 8, 4, 2,
+	ZERO_SI256, LOAD_SI256, STORE_SI256, MULADD_EPI32_256)
+DEFINE_SKINNY_SIMD_KERNEL(skinnyFloat32AVX2, "avx2,fma", float, float, __m256, 8, 4, 2,
+	_mm256_setzero_ps, _mm256_loadu_ps, _mm256_storeu_ps, FMADD_PS_256)
+DEFINE_SKINNY_SIMD_KERNEL(skinnyFloat64AVX2, "avx2,fma", double, double, __m256d, 4, 4, 2,
+	_mm256_setzero_pd, _mm256_loadu_pd, _mm256_storeu_pd, FMADD_PD_256)
+DEFINE_SKINNY_SIMD_KERNEL(skinnyInt64AVX2, "avx2", int64_t, uint64_t, __m256i, 4, 4, 2,
+	ZERO_SI256, LOAD_SI256, STORE_SI256, MULADD_EPI64_256)
+
+DEFINE_SKINNY_SIMD_KERNEL(skinnyInt32AVX512, "avx512f", int32_t, uint32_t, __m512i, 16, 4, 4,
+	ZERO_SI512, LOAD_SI512, STORE_SI512, MULADD_EPI32_512)
+DEFINE_SKINNY_SIMD_KERNEL(skinnyFloat32AVX512, "avx512f", float, float, __m512, 16, 4, 4,
+	_mm512_setzero_ps, _mm512_loadu_ps, _mm512_storeu_ps, FMADD_PS_512)
+DEFINE_SKINNY_SIMD_KERNEL(skinnyFloat64AVX512, "avx512f", double, double, __m512d, 8, 4, 4,
+	_mm512_setzero_pd, _mm512_loadu_pd, _mm512_storeu_pd, FMADD_PD_512)
+DEFINE_SKINNY_SIMD_KERNEL(skinnyInt64AVX512, "avx512f,avx512dq", int64_t, uint64_t, __m512i, 8, 4, 4,
+	ZERO_SI512, LOAD_SI512, STORE_SI512, MULADD_EPI64_512)
+
+DEFINE_SEMIRING_SCALAR_KERNEL(minPlusInt32Scalar, int32_t, INT32_MAX, MIN_PLUS)
+DEFINE_SEMIRING_SCALAR_KERNEL(minPlusFloat32Scalar, float, INFINITY, MIN_PLUS)
+DEFINE_SEMIRING_SCALAR_KERNEL(minPlusFloat64Scalar, double, INFINITY, MIN_PLUS)
+DEFINE_SEMIRING_SCALAR_KERNEL(minPlusInt64Scalar, int64_t, INT64_MAX, MIN_PLUS)
+DEFINE_SEMIRING_SCALAR_KERNEL(maxPlusInt32Scalar, int32_t, INT32_MIN, MAX_PLUS)
+DEFINE_SEMIRING_SCALAR_KERNEL(maxPlusFloat32Scalar, float, -INFINITY, MAX_PLUS)
+DEFINE_SEMIRING_SCALAR_KERNEL(maxPlusFloat64Scalar, double, -INFINITY, MAX_PLUS)
+DEFINE_SEMIRING_SCALAR_KERNEL(maxPlusInt64Scalar, int64_t, INT64_MIN, MAX_PLUS)
+DEFINE_SEMIRING_SCALAR_KERNEL(booleanInt32Scalar, int32_t, 0, OR_AND)
+
+DEFINE_SIMD_KERNEL(minPlusInt32AVX2, "avx2", int32_t, int32_t, __m256i, 8, 4, 2,
+	MAX_EPI32_256, LOAD_SI256, STORE_SI256, _mm256_set1_epi32, MIN_PLUS_EPI32_256)
+DEFINE_SIMD_KERNEL(minPlusFloat32AVX2, "avx2", float, float, __m256, 8, 4, 2,
+	INFINITY_PS_256, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_set1_ps, MIN_PLUS_PS_256)
+DEFINE_SIMD_KERNEL(minPlusFloat64AVX2, "avx2", double, double, __m256d, 4, 4, 2,
+	INFINITY_PD_256, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_set1_pd, MIN_PLUS_PD_256)
+DEFINE_SIMD_KERNEL(minPlusInt64AVX2, "avx2", int64_t, int64_t, __m256i, 4, 4, 2,
+	MAX_EPI64_256, LOAD_SI256, STORE_SI256, _mm256_set1_epi64x, MIN_PLUS_EPI64_256)
+DEFINE_SIMD_KERNEL(maxPlusInt32AVX2, "avx2", int32_t, int32_t, __m256i, 8, 4, 2,
+	MIN_EPI32_256, LOAD_SI256, STORE_SI256, _mm256_set1_epi32, MAX_PLUS_EPI32_256)
+DEFINE_SIMD_KERNEL(maxPlusFloat32AVX2, "avx2", float, float, __m256, 8, 4, 2,
+	NEG_INFINITY_PS_256, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_set1_ps, MAX_PLUS_PS_256)
+DEFINE_SIMD_KERNEL(maxPlusFloat64AVX2, "avx2", double, double, __m256d, 4, 4, 2,
+	NEG_INFINITY_PD_256, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_set1_pd, MAX_PLUS_PD_256)
+DEFINE_SIMD_KERNEL(maxPlusInt64AVX2, "avx2", int64_t, int64_t, __m256i, 4, 4, 2,
+	MIN_EPI64_256, LOAD_SI256, STORE_SI256, _mm256_set1_epi64x, MAX_PLUS_EPI64_256)
+DEFINE_SIMD_KERNEL(booleanInt32AVX2, "avx2", int32_t, int32_t, __m256i, 8, 4, 2,
+	ZERO_SI256, LOAD_SI256, STORE_SI256, _mm256_set1_epi32, OR_AND_256)
+
+DEFINE_SIMD_KERNEL(minPlusInt32AVX512, "avx512f", int32_t, int32_t, __m512i, 16, 8, 1,
+	MAX_EPI32_512, LOAD_SI512, STORE_SI512, _mm512_set1_epi32, MIN_PLUS_EPI32_512)
+DEFINE_SIMD_KERNEL(minPlusFloat32AVX512, "avx512f", float, float, __m512, 16, 8, 1,
+	INFINITY_PS_512, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_set1_ps, MIN_PLUS_PS_512)
+DEFINE_SIMD_KERNEL(minPlusFloat64AVX512, "avx512f", double, double, __m512d, 8, 8, 1,
+	INFINITY_PD_512, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_set1_pd, MIN_PLUS_PD_512)
+DEFINE_SIMD_KERNEL(minPlusInt64AVX512, "avx512f", int64_t, int64_t, __m512i, 8, 8, 1,
+	MAX_EPI64_512, LOAD_SI512, STORE_SI512, _mm512_set1_epi64, MIN_PLUS_EPI64_512)
+DEFINE_SIMD_KERNEL(maxPlusInt32AVX512, "avx512f", int32_t, int32_t, __m512i, 16, 8, 1,
+	MIN_EPI32_512, LOAD_SI512, STORE_SI512, _mm512_set1_epi32, MAX_PLUS_EPI32_512)
+DEFINE_SIMD_KERNEL(maxPlusFloat32AVX512, "avx512f", float, float, __m512, 16, 8, 1,
+	NEG_INFINITY_PS_512, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_set1_ps, MAX_PLUS_PS_512)
+DEFINE_SIMD_KERNEL(maxPlusFloat64AVX512, "avx512f", double, double, __m512d, 8, 8, 1,
+	NEG_INFINITY_PD_512, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_set1_pd, MAX_PLUS_PD_512)
+DEFINE_SIMD_KERNEL(maxPlusInt64AVX512, "avx512f", int64_t, int64_t, __m512i, 8, 8, 1,
+	MIN_EPI64_512, LOAD_SI512, STORE_SI512, _mm512_set1_epi64, MAX_PLUS_EPI64_512)
+DEFINE_SIMD_KERNEL(booleanInt32AVX512, "avx512f", int32_t, int32_t, __m512i, 16, 8, 1,
+	ZERO_SI512, LOAD_SI512, STORE_SI512, _mm512_set1_epi32, OR_AND_512)
+
+DEFINE_MODULAR_SCALAR_KERNEL(modularScalar)
+DEFINE_MODULAR_SIMD_KERNEL(modularAVX2, "avx2", __m256i, 4, 2, 2,
+	ZERO_SI256, LOAD_WIDE_EPU32_256, STORE_SI256, _mm256_set1_epi64x, _mm256_mul_epu32, _mm256_add_epi64, MONTGOMERY_EPI64_256)
+DEFINE_MODULAR_SIMD_KERNEL(modularAVX512, "avx512f", __m512i, 8, 4, 2,
+	ZERO_SI512, LOAD_WIDE_EPU32_512, STORE_SI512, _mm512_set1_epi64, _mm512_mul_epu32, _mm512_add_epi64, MONTGOMERY_EPI64_512)
+
+DEFINE_FOUR_RUSSIANS_KERNEL(fourRussiansScalar, )
+DEFINE_FOUR_RUSSIANS_KERNEL(fourRussiansAVX2, __attribute__((target("avx2"))))
+DEFINE_FOUR_RUSSIANS_KERNEL(fourRussiansAVX512, __attribute__((target("avx512f"))))
+
+DEFINE_RANK_KERNEL(rankInt32Scalar, uint32_t, )
+DEFINE_RANK_KERNEL(rankFloat32Scalar, float, )
+DEFINE_RANK_KERNEL(rankFloat64Scalar, double, )
+DEFINE_RANK_KERNEL(rankInt64Scalar, uint64_t, )
+DEFINE_RANK_KERNEL(rankInt32AVX2, uint32_t, __attribute__((target("avx2"))))
+DEFINE_RANK_KERNEL(rankFloat32AVX2, float, __attribute__((target("avx2,fma"))))
+DEFINE_RANK_KERNEL(rankFloat64AVX2, double, __attribute__((target("avx2,fma"))))
+DEFINE_RANK_KERNEL(rankInt32AVX512, uint32_t, __attribute__((target("avx512f"))))
+DEFINE_RANK_KERNEL(rankFloat32AVX512, float, __attribute__((target("avx512f"))))
+DEFINE_RANK_KERNEL(rankFloat64AVX512, double, __attribute__((target("avx512f"))))
+DEFINE_RANK_KERNEL(rankInt64AVX512, uint64_t, __attribute__((target("avx512f,avx512dq"))))
+
+// bit j of a row of C is the parity of the row of A and'ed with row j of B^T
+// folding the words with xor keeps the parity, so each bit needs only one popcount
+static void bitDotScalar(const uint64_t* A, const uint64_t* B, uint64_t* C, int n, int words, int beginRow, int endRow, uint64_t* table)
+{
+	for (int i = beginRow; i < endRow; i++)
+	{
+		const uint64_t* a = &A[(long)i * words];
+
+		for (int word = 0; word < words; word++)
+		{
+			uint64_t bits = 0;
+
+			for (int j = word * 64; j < (word + 1) * 64 && j < n; j++)
+			{
+				const uint64_t* b = &B[(long)j * words];
+				uint64_t fold = 0;
+
+				for (int w = 0; w < words; w++)
+					fold ^= a[w] & b[w];
+
+				bits |= (uint64_t)__builtin_parityll(fold) << (j % 64);
+			}
+
+			C[(long)i * words + word] = bits;
+		}
+	}
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq")))
+static void bitDotAVX512(const uint64_t* A, const uint64_t* B, uint64_t* C, int n, int words, int beginRow, int endRow, uint64_t* table)
+{
+	__mmask8 tail = (__mmask8)((1u << (words % 8)) - 1);
+
+	for (int i = beginRow; i < endRow; i++)
+	{
+		const uint64_t* a = &A[(long)i * words];
+
+		for (int word = 0; word < words; word++)
+		{
+			uint64_t bits = 0;
+
+			for (int j = word * 64; j < (word + 1) * 64 && j < n; j++)
+			{
+				const uint64_t* b = &B[(long)j * words];
+				__m512i fold = _mm512_setzero_si512();
+				int w = 0;
+
+				for (; w + 8 <= words; w += 8)
+					fold = _mm512_xor_si512(fold, _mm512_and_si512(LOAD_SI512(&a[w]), LOAD_SI512(&b[w])));
+
+				if (tail != 0)
+					fold = _mm512_xor_si512(fold, _mm512_and_si512(_mm512_maskz_loadu_epi64(tail, &a[w]),
+						_mm512_maskz_loadu_epi64(tail, &b[w])));
+
+				bits |= (uint64_t)(_mm512_reduce_add_epi64(_mm512_popcnt_epi64(fold)) & 1) << (j % 64);
+			}
+
+			C[(long)i * words + word] = bits;
+		}
+	}
+}
+
+static void* allocateScratch(size_t bytes)
+{
+	void* scratch = malloc(bytes);
+
+	if (scratch == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
+	return scratch;
+}
+
+// per thread buffer the narrow kernels widen A into, freed when the thread exits
+static void* threadScratch(size_t bytes)
+{
+	size_t* scratch = (size_t*)pthread_getspecific(scratchKey);
+
+	if (scratch == NULL || scratch[0] < bytes)
+	{
+		free(scratch);
+
+		// the size sits in front of the buffer, 64 bytes keeps the buffer itself aligned like malloc's
+		scratch = (size_t*)malloc(64 + bytes);
+
+		if (scratch == NULL)
+		{
+			printf("Out of memory\n");
+			exit(-1);
+		}
+
+		scratch[0] = bytes;
+		pthread_setspecific(scratchKey, scratch);
+	}
+
+	return (char*)scratch + 64;
+}
+
+// int16 tiles: the k pairs of B interleaved per column
+static void packPairs16(const void* B, void* packed, int n)
+{
+	const int16_t* tileB = (const int16_t*)B;
+	int16_t* packedB = (int16_t*)packed;
+
+	for (int k = 0; k < n; k += 2)
+		for (int j = 0; j < n; j++)
+		{
+			packedB[k * n + 2 * j] = tileB[k * n + j];
+			packedB[k * n + 2 * j + 1] = tileB[(k + 1) * n + j];
+		}
+}
+
+// 8 bit tiles without vnni: B widened to 16 bit pairs
+static void packPairs8(const void* B, void* packed, int n)
+{
+	const int8_t* tileB = (const int8_t*)B;
+	int16_t* packedB = (int16_t*)packed;
+
+	for (int k = 0; k < n; k += 2)
+		for (int j = 0; j < n; j++)
+		{
+			packedB[k * n + 2 * j] = tileB[k * n + j];
+			packedB[k * n + 2 * j + 1] = tileB[(k + 1) * n + j];
+		}
+}
+
+// 8 bit tiles with vnni: four k values per column
+static void packQuads8(const void* B, void* packed, int n)
+{
+	const int8_t* tileB = (const int8_t*)B;
+	int8_t* packedB = (int8_t*)packed;
+
+	for (int k = 0; k < n; k += 4)
+		for (int j = 0; j < n; j++)
+			for (int q = 0; q < 4; q++)
+				packedB[k * n + 4 * j + q] = tileB[(k + q) * n + j];
+}
+
+// signed A is shifted up by 128 for vpdpbusd, so the column sums of B follow the quads to take it back out
+static void packQuadsInt8(const void* B, void* packed, int n)
+{
+	const int8_t* tileB = (const int8_t*)B;
+	int32_t* columnSums = (int32_t*)((int8_t*)packed + n * n);
+
+	packQuads8(B, packed, n);
+
+	for (int j = 0; j < n; j++)
+	{
+		columnSums[j] = 0;
+
+		for (int k = 0; k < n; k++)
+			columnSums[j] += tileB[k * n + j];
+	}
+}
+
+// int16 tiles: rows of A already hold k pairs
+static void multiplyPairs16(const void* A, const void* B, void* C, int n, DotKernel dot)
+{
+	memset(C, 0, sizeof(int32_t) * n * n);
+	dot(A, (const int32_t*)B, (int32_t*)C, n, n / 2);
+}
+
+// 8 bit tiles without vnni: A is widened to 16 bit pairs to match B
+static void multiplyPairs8(const void* A, const void* B, void* C, int n, DotKernel dot, int signedA)
+{
+	int16_t* wideA = (int16_t*)threadScratch(sizeof(int16_t) * n * n);
+
+	for (int i = 0; i < n * n; i++)
+		wideA[i] = signedA ? ((const int8_t*)A)[i] : ((const uint8_t*)A)[i];
+
+	memset(C, 0, sizeof(int32_t) * n * n);
+	dot(wideA, (const int32_t*)B, (int32_t*)C, n, n / 2);
+}
+
+// 8 bit tiles with vnni: vpdpbusd takes unsigned A and signed B four k values at a time
+static void multiplyQuads8(const void* A, const void* B, void* C, int n, DotKernel dot, int signedA)
+{
+	int32_t* tileC = (int32_t*)C;
+	uint8_t* unsignedA = NULL;
+
+	if (signedA)
+	{
+		// shift A up by 128 and take 128 * (column sum of B) back out through the seed of C
+		const int32_t* columnSums = (const int32_t*)((const int8_t*)B + n * n);
+
+		unsignedA = (uint8_t*)threadScratch(n * n);
+
+		for (int i = 0; i < n * n; i++)
+			unsignedA[i] = ((const uint8_t*)A)[i] ^ 0x80;
+
+		for (int j = 0; j < n; j++)
+			tileC[j] = -128 * columnSums[j];
+
+		for (int i = 1; i < n; i++)
+			memcpy(&tileC[i * n], tileC, sizeof(int32_t) * n);
+	}
+	else
+		memset(C, 0, sizeof(int32_t) * n * n);
+
+	dot(signedA ? unsignedA : A, (const int32_t*)B, tileC, n, n / 4);
+}
+
+static void multiplyPairsInt8(const void* A, const void* B, void* C, int n, DotKernel dot)
+{
+	multiplyPairs8(A, B, C, n, dot, 1);
+}
+
+static void multiplyPairsUInt8(const void* A, const void* B, void* C, int n, DotKernel dot)
+{
+	multiplyPairs8(A, B, C, n, dot, 0);
+}
+
+static void multiplyQuadsInt8(const void* A, const void* B, void* C, int n, DotKernel dot)
+{
+	multiplyQuads8(A, B, C, n, dot, 1);
+}
+
+static void multiplyQuadsUInt8(const void* A, const void* B, void* C, int n, DotKernel dot)
+{
+	multiplyQuads8(A, B, C, n, dot, 0);
+}
+
+// bind a packing driver to one isa's dot kernel
+#define DEFINE_NARROW_KERNEL(name, driver, dot) \
+static void name(const void* A, const void* B, void* C, int n) \
+{ \
+	driver(A, B, C, n, dot); \
+}
+
+DEFINE_NARROW_KERNEL(multiplyInt16AVX2, multiplyPairs16, dotPairsAVX2)
+DEFINE_NARROW_KERNEL(multiplyInt8AVX2, multiplyPairsInt8, dotPairsAVX2)
+DEFINE_NARROW_KERNEL(multiplyUInt8AVX2, multiplyPairsUInt8, dotPairsAVX2)
+DEFINE_NARROW_KERNEL(multiplyInt16AVXVNNI, multiplyPairs16, dotPairsAVXVNNI)
+DEFINE_NARROW_KERNEL(multiplyInt8AVXVNNI, multiplyQuadsInt8, dotQuadsAVXVNNI)
+DEFINE_NARROW_KERNEL(multiplyUInt8AVXVNNI, multiplyQuadsUInt8, dotQuadsAVXVNNI)
+DEFINE_NARROW_KERNEL(multiplyInt16AVX512, multiplyPairs16, dotPairsAVX512VNNI)
+DEFINE_NARROW_KERNEL(multiplyInt8AVX512, multiplyQuadsInt8, dotQuadsAVX512VNNI)
+DEFINE_NARROW_KERNEL(multiplyUInt8AVX512, multiplyQuadsUInt8, dotQuadsAVX512VNNI)
+
+static void selectKernels()
+{
+	// MMULT_ISA caps the instruction set (scalar, avx2, avxvnni or avx512) for benchmarking
+	const char* cap = getenv("MMULT_ISA");
+	ISALevel maxLevel = isaAVX512;
+
+	if (cap != NULL)
+	{
+		if (strcmp(cap, "scalar") == 0)
+			maxLevel = isaScalar;
+		else if (strcmp(cap, "avx2") == 0)
+			maxLevel = isaAVX2;
+		else if (strcmp(cap, "avxvnni") == 0)
+			maxLevel = isaAVXVNNI;
+	}
+
+	__builtin_cpu_init();
+
+	if (pthread_key_create(&scratchKey, free) != 0)
+	{
+		printf("Cannot create the kernel scratch\n");
+		exit(-1);
+	}
+
+	int avx2 = maxLevel >= isaAVX2 && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+	int avxvnni = maxLevel >= isaAVXVNNI && avx2 && __builtin_cpu_supports("avxvnni");
+	int avx512 = maxLevel >= isaAVX512 && __builtin_cpu_supports("avx512f");
+
+	tileKernels[typeInt32] = multiplyInt32Scalar;
+	tileKernels[typeFloat32] = multiplyFloat32Scalar;
+	tileKernels[typeFloat64] = multiplyFloat64Scalar;
+	tileKernels[typeInt64] = multiplyInt64Scalar;
+	tileKernels[typeInt16] = multiplyInt16Scalar;
+	tileKernels[typeInt8] = multiplyInt8Scalar;
+	tileKernels[typeUInt8] = multiplyUInt8Scalar;
+	wideTileKernel = multiplyInt32WideScalar;
+
+	sparseKernels[sparseCSR][typeInt32] = sparseRowInt32Scalar;
+	sparseKernels[sparseCSR][typeFloat32] = sparseRowFloat32Scalar;
+	sparseKernels[sparseCSR][typeFloat64] = sparseRowFloat64Scalar;
+	sparseKernels[sparseCSR][typeInt64] = sparseRowInt64Scalar;
+	sparseKernels[sparseBSR][typeInt32] = sparseBlockInt32Scalar;
+	sparseKernels[sparseBSR][typeFloat32] = sparseBlockFloat32Scalar;
+	sparseKernels[sparseBSR][typeFloat64] = sparseBlockFloat64Scalar;
+	sparseKernels[sparseBSR][typeInt64] = sparseBlockInt64Scalar;
+
+	skinnyKernels[typeInt32] = skinnyInt32Scalar;
+	skinnyKernels[typeFloat32] = skinnyFloat32Scalar;
+	skinnyKernels[typeFloat64] = skinnyFloat64Scalar;
+	skinnyKernels[typeInt64] = skinnyInt64Scalar;
+	skinnyKernels[typeInt16] = skinnyInt16Scalar;
+	skinnyKernels[typeInt8] = skinnyInt8Scalar;
+	skinnyKernels[typeUInt8] = skinnyUInt8Scalar;
+
+	bitKernels[bitDot] = bitDotScalar;
+	bitKernels[bitFourRussians] = fourRussiansScalar;
+
+	rankKernels[typeInt32] = rankInt32Scalar;
+	rankKernels[typeFloat32] = rankFloat32Scalar;
+	rankKernels[typeFloat64] = rankFloat64Scalar;
+	rankKernels[typeInt64] = rankInt64Scalar;
+
+	semiringKernels[semiringMinPlus][typeInt32] = minPlusInt32Scalar;
+	semiringKernels[semiringMinPlus][typeFloat32] = minPlusFloat32Scalar;
+	semiringKernels[semiringMinPlus][typeFloat64] = minPlusFloat64Scalar;
+	semiringKernels[semiringMinPlus][typeInt64] = minPlusInt64Scalar;
+	semiringKernels[semiringMaxPlus][typeInt32] = maxPlusInt32Scalar;
+	semiringKernels[semiringMaxPlus][typeFloat32] = maxPlusFloat32Scalar;
+	semiringKernels[semiringMaxPlus][typeFloat64] = maxPlusFloat64Scalar;
+	semiringKernels[semiringMaxPlus][typeInt64] = maxPlusInt64Scalar;
+	semiringKernels[semiringBoolean][typeInt32] = booleanInt32Scalar;
+
+	modularKernel = modularScalar;
+
+	if (avx2)
+	{
+		tileKernels[typeInt32] = multiplyInt32AVX2;
+		tileKernels[typeFloat32] = multiplyFloat32AVX2;
+		tileKernels[typeFloat64] = multiplyFloat64AVX2;
+		tileKernels[typeInt64] = multiplyInt64AVX2;
+		tileKernels[typeInt16] = multiplyInt16AVX2;
+		tileKernels[typeInt8] = multiplyInt8AVX2;
+		tileKernels[typeUInt8] = multiplyUInt8AVX2;
+		wideTileKernel = multiplyInt32WideAVX2;
+
+		tilePackers[typeInt16] = packPairs16;
+		tilePackers[typeInt8] = packPairs8;
+		tilePackers[typeUInt8] = packPairs8;
+
+		sparseKernels[sparseCSR][typeInt32] = sparseRowInt32AVX2;
+		sparseKernels[sparseCSR][typeFloat32] = sparseRowFloat32AVX2;
+		sparseKernels[sparseCSR][typeFloat64] = sparseRowFloat64AVX2;
+		sparseKernels[sparseCSR][typeInt64] = sparseRowInt64AVX2;
+		sparseKernels[sparseBSR][typeInt32] = sparseBlockInt32AVX2;
+		sparseKernels[sparseBSR][typeFloat32] = sparseBlockFloat32AVX2;
+		sparseKernels[sparseBSR][typeFloat64] = sparseBlockFloat64AVX2;
+		sparseKernels[sparseBSR][typeInt64] = sparseBlockInt64AVX2;
+
+		skinnyKernels[typeInt32] = skinnyInt32AVX2;
+		skinnyKernels[typeFloat32] = skinnyFloat32AVX2;
+		skinnyKernels[typeFloat64] = skinnyFloat64AVX2;
+		skinnyKernels[typeInt64] = skinnyInt64AVX2;
+
+		bitKernels[bitFourRussians] = fourRussiansAVX2;
+
+		rankKernels[typeInt32] = rankInt32AVX2;
+		rankKernels[typeFloat32] = rankFloat32AVX2;
+		rankKernels[typeFloat64] = rankFloat64AVX2;
+
+		semiringKernels[semiringMinPlus][typeInt32] = minPlusInt32AVX2;
+		semiringKernels[semiringMinPlus][typeFloat32] = minPlusFloat32AVX2;
+		semiringKernels[semiringMinPlus][typeFloat64] = minPlusFloat64AVX2;
+		semiringKernels[semiringMinPlus][typeInt64] = minPlusInt64AVX2;
+		semiringKernels[semiringMaxPlus][typeInt32] = maxPlusInt32AVX2;
+		semiringKernels[semiringMaxPlus][typeFloat32] = maxPlusFloat32AVX2;
+		semiringKernels[semiringMaxPlus][typeFloat64] = maxPlusFloat64AVX2;
+		semiringKernels[semiringMaxPlus][typeInt64] = maxPlusInt64AVX2;
+		semiringKernels[semiringBoolean][typeInt32] = booleanInt32AVX2;
+
+		modularKernel = modularAVX2;
+	}
+
+	if (avxvnni)
+	{
+		tileKernels[typeInt16] = multiplyInt16AVXVNNI;
+		tileKernels[typeInt8] = multiplyInt8AVXVNNI;
+		tileKernels[typeUInt8] = multiplyUInt8AVXVNNI;
+
+		tilePackers[typeInt8] = packQuadsInt8;
+		tilePackers[typeUInt8] = packQuads8;
+	}
+
+	if (avx512)
+	{
+		tileKernels[typeInt32] = multiplyInt32AVX512;
+		tileKernels[typeFloat32] = multiplyFloat32AVX512;
+		tileKernels[typeFloat64] = multiplyFloat64AVX512;
+		wideTileKernel = multiplyInt32WideAVX512;
+
+		sparseKernels[sparseCSR][typeInt32] = sparseRowInt32AVX512;
+		sparseKernels[sparseCSR][typeFloat32] = sparseRowFloat32AVX512;
+		sparseKernels[sparseCSR][typeFloat64] = sparseRowFloat64AVX512;
+		sparseKernels[sparseBSR][typeInt32] = sparseBlockInt32AVX512;
+		sparseKernels[sparseBSR][typeFloat32] = sparseBlockFloat32AVX512;
+		sparseKernels[sparseBSR][typeFloat64] = sparseBlockFloat64AVX512;
+
+		skinnyKernels[typeInt32] = skinnyInt32AVX512;
+		skinnyKernels[typeFloat32] = skinnyFloat32AVX512;
+		skinnyKernels[typeFloat64] = skinnyFloat64AVX512;
+
+		bitKernels[bitFourRussians] = fourRussiansAVX512;
+
+		rankKernels[typeInt32] = rankInt32AVX512;
+		rankKernels[typeFloat32] = rankFloat32AVX512;
+		rankKernels[typeFloat64] = rankFloat64AVX512;
+		rankKernels[typeInt64] = rankInt64AVX512;
+
+		semiringKernels[semiringMinPlus][typeInt32] = minPlusInt32AVX512;
+		semiringKernels[semiringMinPlus][typeFloat32] = minPlusFloat32AVX512;
+		semiringKernels[semiringMinPlus][typeFloat64] = minPlusFloat64AVX512;
+		semiringKernels[semiringMinPlus][typeInt64] = minPlusInt64AVX512;
+		semiringKernels[semiringMaxPlus][typeInt32] = maxPlusInt32AVX512;
+		semiringKernels[semiringMaxPlus][typeFloat32] = maxPlusFloat32AVX512;
+		semiringKernels[semiringMaxPlus][typeFloat64] = maxPlusFloat64AVX512;
+		semiringKernels[semiringMaxPlus][typeInt64] = maxPlusInt64AVX512;
+		semiringKernels[semiringBoolean][typeInt32] = booleanInt32AVX512;
+
+		modularKernel = modularAVX512;
+
+		if (__builtin_cpu_supports("avx512vpopcntdq"))
+			bitKernels[bitDot] = bitDotAVX512;
+
+		if (__builtin_cpu_supports("avx512dq"))
+		{
+			tileKernels[typeInt64] = multiplyInt64AVX512;
+			sparseKernels[sparseCSR][typeInt64] = sparseRowInt64AVX512;
+			sparseKernels[sparseBSR][typeInt64] = sparseBlockInt64AVX512;
+			skinnyKernels[typeInt64] = skinnyInt64AVX512;
+		}
+
+		if (__builtin_cpu_supports("avx512vnni"))
+		{
+			tileKernels[typeInt16] = multiplyInt16AVX512;
+			tileKernels[typeInt8] = multiplyInt8AVX512;
+			tileKernels[typeUInt8] = multiplyUInt8AVX512;
+
+			tilePackers[typeInt8] = packQuadsInt8;
+			tilePackers[typeUInt8] = packQuads8;
+		}
+	}
+}
+
+TileKernel getTileKernel(ElementType type, AccumulateMode accumulate)
+{
+	pthread_once(&selectKernelsOnce, selectKernels);
+
+	// only int32 operands have a wider accumulator to move to
+	if (accumulate != accumulateNative && type == typeInt32)
+		return wideTileKernel;
+
+	return tileKernels[type];
+}
+
+TilePacker getTilePacker(ElementType type, int n, size_t* bytes)
+{
+	pthread_once(&selectKernelsOnce, selectKernels);
+
+	TilePacker packer = tilePackers[type];
+
+	if (packer == packPairs8)
+		*bytes = sizeof(int16_t) * n * n;
+	else if (packer == packQuadsInt8)
+		*bytes = (size_t)n * n + sizeof(int32_t) * n;
+	else
+		*bytes = (size_t)elementInfo[type].sizeB * n * n;
+
+	return packer;
+}
+
+SparseKernel getSparseKernel(ElementType type, SparseFormat format)
+{
+	pthread_once(&selectKernelsOnce, selectKernels);
+
+	return sparseKernels[format][type];
+}
+
+SkinnyKernel getSkinnyKernel(ElementType type)
+{
+	pthread_once(&selectKernelsOnce, selectKernels);
+
+	return skinnyKernels[type];
+}
+
+TileKernel getSemiringKernel(ElementType type, Semiring semiring)
+{
+	pthread_once(&selectKernelsOnce, selectKernels);
+
+	return semiringKernels[semiring][type];
+}
+
+ModularKernel getModularKernel()
+{
+	pthread_once(&selectKernelsOnce, selectKernels);
+
+	return modularKernel;
+}
+
+RankKernel getRankKernel(ElementType type)
+{
+	pthread_once(&selectKernelsOnce, selectKernels);
+
+	return rankKernels[type];
+}
+
+BitKernel getBitKernel(BitMethod method)
+{
+	pthread_once(&selectKernelsOnce, selectKernels);
+
+	return bitKernels[method];
+}
+
 void split(int* P, int* C, int iB, int jB, int N) ;
 void add(int* A, int* B, int N, int* C) ;
 void sub(int* A, int* B, int N, int* C) ;
@@ -108,37 +833,103 @@ void multiplyCPU(void* data)
 {
 	SchedPass* sp = (SchedPass*)data;
 
-	int* A = sp->A;
-	int* B = sp->B;
-	pthread_mutex_t* groupLock = sp->groupLock;
-	pthread_cond_t* groupSignal = sp->groupSignal;
-	int* groupProgress = sp->groupProgress;
-
+	void* A = sp->A;
+	void* B = sp->B;
 	int dimension = sp->dimension;
-	int blocksPerGroup = sp->blocksPerGroup;
-	int matrixWidth = blocksPerGroup * dimension;
-	int* writeBack = sp->writeBack;
-	int* outputSpot = sp->outputSpot;
+	void* writeBack = sp->writeBack;
 
 #ifndef NO_STRASSEN
-    // multiply through Strassen's algorithm
-	multiply(A, B, dimension, writeBack);
+	// multiply through Strassen's algorithm (integer tiles only)
+	if (sp->type == typeInt32 && sp->accumulate == accumulateNative && sp->semiring == semiringArithmetic && sp->modulus == NULL)
+	{
+		multiply((int*)A, (int*)B, dimension, (int*)writeBack);
+		blockSum(sp);
+		return;
+	}
 #endif
 
-#ifdef NO_STRASSEN
-	// zero out write back
-	for (int i = 0; i < dimension; i++)
-		for (int j = 0; j < dimension; j++)
-			for (int k = 0; k < dimension; k++)
-				writeBack[j + i * dimension] = 0;
-
 	// calculate the dot product on the cpu
-	for (int i = 0; i < dimension; i++)
-		for (int j = 0; j < dimension; j++)
-			for (int k = 0; k < dimension; k++)
-				writeBack[j + i * dimension] += A[i * dimension + k] * B[k * dimension + j];
-#endif
+	if (sp->modulus != NULL)
+		getModularKernel()(A, B, writeBack, dimension, sp->modulus);
+	else if (sp->semiring != semiringArithmetic)
+		getSemiringKernel(sp->type, sp->semiring)(A, B, writeBack, dimension);
+	else
+		getTileKernel(sp->type, sp->accumulate)(A, B, writeBack, dimension);
 
 	// sum up the block and delete excess data
 	blockSum(data);
 }
+
+void multiplySparse(void* data)
+{
+	SparsePass* sp = (SparsePass*)data;
+	SparseMatrix* A = sp->A;
+
+	int dimension = A->dimension;
+	int blockSize = A->blockSize;
+	long blockBytes = (long)elementInfo[A->type].sizeA * blockSize * blockSize;
+	long rowBytes = (long)elementInfo[A->type].sizeOut * blockSize * dimension;
+	SparseKernel kernel = getSparseKernel(A->type, A->format);
+
+	for (int blockRow = sp->beginRow; blockRow < sp->endRow; blockRow++)
+	{
+		long start = A->rowStart[blockRow];
+		long count = A->rowStart[blockRow + 1] - start;
+		char* C = (char*)sp->C + blockRow * rowBytes;
+
+		// nothing to multiply for an empty row
+		if (count == 0)
+			memset(C, 0, rowBytes);
+		else
+			kernel((const char*)A->values + start * blockBytes, &A->colIndex[start], count, sp->B, C, dimension);
+
+		// finish the block row while it is still in cache
+		if (sp->epilogue != NULL)
+			applyEpilogue(sp->epilogue, elementInfo[A->type].outType, C, dimension, blockSize, dimension, 0);
+	}
+
+	free(sp);
+}
+
+void multiplySkinny(void* data)
+{
+	SkinnyPass* sp = (SkinnyPass*)data;
+
+	getSkinnyKernel(sp->type)(sp->A, sp->B, sp->C, sp->dimension, sp->columns, sp->beginRow, sp->endRow);
+
+	if (sp->epilogue != NULL)
+		applyEpilogue(sp->epilogue, elementInfo[sp->type].outType,
+			(char*)sp->C + (long)sp->beginRow * sp->columns * elementInfo[sp->type].sizeOut, sp->columns,
+			sp->endRow - sp->beginRow, sp->columns, 0);
+
+	free(sp);
+}
+
+void multiplyRank(void* data)
+{
+	LowRankPass* lp = (LowRankPass*)data;
+	int elementSize = elementInfo[lp->type].sizeOut;
+
+	if (lp->clear)
+		memset((char*)lp->C + (long)lp->beginRow * lp->columns * elementSize, 0,
+			(size_t)(lp->endRow - lp->beginRow) * lp->columns * elementSize);
+
+	getRankKernel(lp->type)(lp->X, lp->Y, lp->C, lp->inner, lp->columns, lp->beginRow, lp->endRow);
+
+	free(lp);
+}
+
+void multiplyBits(void* data)
+{
+	BitPass* bp = (BitPass*)data;
+	uint64_t* table = NULL;
+
+	// one row of words for each of the 256 sums
+	if (bp->method == bitFourRussians)
+		table = (uint64_t*)allocateScratch(sizeof(uint64_t) * 256 * bp->words);
+
+	getBitKernel(bp->method)(bp->A, bp->B, bp->C, bp->dimension, bp->words, bp->beginRow, bp->endRow, table);
+
+	free(table);
+	free(bp);
+}
@@ -1,6 +1,59 @@
 #ifndef MMULTCPU_H
 #define MMULTCPU_H
 
+#include "elementType.h"
+#include "sparseMatrix.h"
+#include "bitMatrix.h"
+#include "modular.h"
+
+// computes C = A * B for n x n row-major tiles, B rearranged by the type's packer when it has one
+typedef void (*TileKernel)(const void* A, const void* B, void* C, int n);
+
+TileKernel getTileKernel(ElementType type, AccumulateMode accumulate);
+
+// rearranges an n x n row-major B tile into the order the type's tile kernel reads it in
+typedef void (*TilePacker)(const void* B, void* packed, int n);
+
+// null when the tile kernel reads B as stored, otherwise every B tile has to go through the packer first
+// bytes gets the size of a packed tile either way
+TilePacker getTilePacker(ElementType type, int n, size_t* bytes);
+
+// null when the semiring has no kernel for the type
+TileKernel getSemiringKernel(ElementType type, Semiring semiring);
+
+// computes C = A * B mod modulus for n x n row-major tiles of int32 residues
+typedef void (*ModularKernel)(const void* A, const void* B, void* C, int n, const Modulus* modulus);
+
+ModularKernel getModularKernel();
+
+// computes block rows of C = A * B for a compressed A, see kernelTemplates.h
+typedef void (*SparseKernel)(const void* values, const int* cols, long count, const void* B, void* C, int n);
+
+SparseKernel getSparseKernel(ElementType type, SparseFormat format);
+
+// computes rows [beginRow, endRow) of C = A * B for a B given as columns x n, see kernelTemplates.h
+typedef void (*SkinnyKernel)(const void* A, const void* B, void* C, int n, int columns, int beginRow, int endRow);
+
+SkinnyKernel getSkinnyKernel(ElementType type);
+
+// computes rows [beginRow, endRow) of C = A * B over GF(2), table holds 256 rows of words for four russians
+typedef void (*BitKernel)(const uint64_t* A, const uint64_t* B, uint64_t* C, int n, int words, int beginRow, int endRow, uint64_t* table);
+
+BitKernel getBitKernel(BitMethod method);
+
+// adds rows [beginRow, endRow) of X * Y to C, X has inner columns and Y is inner x columns, null for mixed types
+typedef void (*RankKernel)(const void* X, const void* Y, void* C, int inner, int columns, int beginRow, int endRow);
+
+RankKernel getRankKernel(ElementType type);
+
 void multiplyCPU(void* data);
 
+void multiplySparse(void* data);
+
+void multiplySkinny(void* data);
+
+void multiplyBits(void* data);
+
+void multiplyRank(void* data);
+
 #endif
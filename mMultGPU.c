@@ -2,23 +2,96 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
 
-#include <X11/X.h>
-#include <X11/Xlib.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
 
-#include <GL/glew.h>
-#include <GL/freeglut.h>
-
-#include <GL/glx.h>
+#define GL_GLEXT_PROTOTYPES
+#include <GL/glcorearb.h>
 
 #include "scheduler.h"
 #include "blockSum.h"
+#include "mMultGPU.h"
+
+#define GPU_RING_SIZE 4
+#define GPU_TILE_BYTES (64 * 64 * sizeof(double))
+#define GPU_TIMEOUT (1000 * 1000 * 1000)
+#define GPU_MAP_FLAGS (GL_MAP_WRITE_BIT | GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT)
+#define MAX_TUNED_SHAPES 16
+#define SHADER_CACHE_MAGIC 0x4d4d5042 // "MMPB"
 
 int threadSize;
 
-GLuint bufferIndex[3];
+EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+EGLContext eglContext = EGL_NO_CONTEXT;
+
+// persistently mapped storage buffers for A, B and the result along with the batch in flight on them
+typedef struct
+{
+	GLuint buffer[3];
+	void* mapped[3];
+	GLsizeiptr capacity;
+	GLsizeiptr tileBytes;
+	GLsync fence;
+	GPUBatch* batch;
+} GPUBufferSet;
+
+// batches are uploaded at ringNext and read back from ringOldest in order
+GPUBufferSet bufferRing[GPU_RING_SIZE];
+int ringNext, ringOldest, ringInFlight;
+
+// shapes of the register tiling the shader is built with
+typedef struct
+{
+	int groupSize;
+	int microTile;
+	int vectorWidth;
+} ShaderVariant;
+
+static const ShaderVariant shaderVariants[] =
+{
+	{ 16, 1, 1 }, // one output per invocation, always fits
+	{ 16, 2, 2 },
+	{ 16, 4, 4 },
+	{ 8, 4, 4 },
+	{ 8, 8, 4 }
+};
+
+#define NUM_VARIANTS (int)(sizeof(shaderVariants) / sizeof(ShaderVariant))
+
+// every variant for each element type the shader can be built for (0 when not supported)
+GLuint variantShader[numElementTypes][NUM_VARIANTS];
+
+// the fastest variant for a type and tile size, compiled with the size baked in
+typedef struct
+{
+	ElementType type;
+	int dimension;
+	int blockSize;
+	GLuint program;
+} TunedShader;
+
+TunedShader tunedShaders[MAX_TUNED_SHAPES];
+int numTuned;
 
-GLuint blockMatrixShader;
+const char* shaderElementType[numElementTypes] =
+{
+	[typeInt32] = "int",
+	[typeFloat32] = "float",
+	[typeFloat64] = "double"
+};
+
+const char* shaderVectorType[numElementTypes] =
+{
+	[typeInt32] = "ivec",
+	[typeFloat32] = "vec",
+	[typeFloat64] = "dvec"
+};
 
 typedef struct
 {
@@ -32,7 +105,7 @@ void checkError()
 
 	if (status != GL_NO_ERROR)
 	{
-		printf("Error: %s (%i)", gluErrorString(status), status);
+		printf("Error: OpenGL error 0x%x", status);
 		exit(EXIT_FAILURE);
 	}
 }
@@ -67,7 +140,167 @@ ShaderData* readShader(const char *filename)
 	return sd;
 }
 
-GLuint compileShader(const char *filename)
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+{
+	// fnv-1a
+	const unsigned char* bytes = (const unsigned char*)data;
+
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+
+	return hash;
+}
+
+static uint64_t hashString(uint64_t hash, const char* string)
+{
+	// keep the terminator so "ab" + "c" and "a" + "bc" differ
+	return hashBytes(hash, string == NULL ? "" : string, string == NULL ? 1 : strlen(string) + 1);
+}
+
+// MMULT_SHADER_CACHE overrides ~/.cache/mmult, returns 0 when there is nowhere to cache
+static int shaderCachePath(char* path, size_t size, uint64_t key)
+{
+	const char* dir = getenv("MMULT_SHADER_CACHE");
+	char defaultDir[512];
+
+	if (dir == NULL)
+	{
+		const char* home = getenv("HOME");
+
+		if (home == NULL)
+			return 0;
+
+		snprintf(defaultDir, sizeof(defaultDir), "%s/.cache", home);
+		mkdir(defaultDir, 0755);
+		snprintf(defaultDir, sizeof(defaultDir), "%s/.cache/mmult", home);
+		dir = defaultDir;
+	}
+
+	// an existing directory is fine, anything else leaves the shaders uncached
+	if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+	{
+		static int warned = 0;
+
+		if (!warned)
+			printf("Cannot create shader cache %s, compiling shaders from source\n", dir);
+
+		warned = 1;
+		return 0;
+	}
+
+	snprintf(path, size, "%s/%016llx.bin", dir, (unsigned long long)key);
+
+	return 1;
+}
+
+// the driver strings are part of the key so a driver update never loads a stale binary
+static uint64_t shaderCacheKey(const char* source, const char* defines)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	hash = hashString(hash, source);
+	hash = hashString(hash, defines);
+	hash = hashString(hash, (const char*)glGetString(GL_VENDOR));
+	hash = hashString(hash, (const char*)glGetString(GL_RENDERER));
+	hash = hashString(hash, (const char*)glGetString(GL_VERSION));
+
+	return hash;
+}
+
+// file layout: magic, key, binary format, binary length, binary
+static GLuint loadCachedProgram(uint64_t key)
+{
+	char path[600];
+
+	if (!shaderCachePath(path, sizeof(path), key))
+		return 0;
+
+	FILE* file = fopen(path, "rb");
+
+	if (file == NULL)
+		return 0;
+
+	uint32_t magic = 0;
+	uint64_t storedKey = 0;
+	GLenum format = 0;
+	GLint length = 0;
+	GLuint program = 0;
+
+	if (fread(&magic, sizeof(magic), 1, file) == 1 && magic == SHADER_CACHE_MAGIC
+		&& fread(&storedKey, sizeof(storedKey), 1, file) == 1 && storedKey == key
+		&& fread(&format, sizeof(format), 1, file) == 1 && fread(&length, sizeof(length), 1, file) == 1 && length > 0)
+	{
+		void* binary = malloc(length);
+
+		if (binary != NULL && fread(binary, 1, length, file) == (size_t)length)
+		{
+			GLint result = GL_FALSE;
+
+			program = glCreateProgram();
+			glProgramBinary(program, format, binary, length);
+
+			// a format the driver no longer accepts raises an error, clear it here so later checks only see their own
+			GLenum error = glGetError();
+
+			if (error == GL_NO_ERROR)
+				glGetProgramiv(program, GL_LINK_STATUS, &result);
+
+			// the driver rejected it, compile from source instead
+			if (result != GL_TRUE)
+			{
+				glDeleteProgram(program);
+				program = 0;
+			}
+		}
+
+		free(binary);
+	}
+
+	fclose(file);
+
+	return program;
+}
+
+static void storeCachedProgram(GLuint program, uint64_t key)
+{
+	char path[600], tempPath[620];
+	GLint length = 0;
+	GLenum format = 0;
+	uint32_t magic = SHADER_CACHE_MAGIC;
+
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+
+	if (length <= 0 || !shaderCachePath(path, sizeof(path), key))
+		return;
+
+	void* binary = malloc(length);
+
+	if (binary == NULL)
+		return;
+
+	glGetProgramBinary(program, length, &length, &format, binary);
+
+	// write beside the final name and rename so concurrent processes never read half a file
+	snprintf(tempPath, sizeof(tempPath), "%s.%i", path, (int)getpid());
+
+	FILE* file = fopen(tempPath, "wb");
+
+	if (file != NULL)
+	{
+		int written = fwrite(&magic, sizeof(magic), 1, file) == 1 && fwrite(&key, sizeof(key), 1, file) == 1
+			&& fwrite(&format, sizeof(format), 1, file) == 1 && fwrite(&length, sizeof(length), 1, file) == 1
+			&& fwrite(binary, 1, length, file) == (size_t)length;
+
+		if (fclose(file) == 0 && written)
+			rename(tempPath, path);
+		else
+			unlink(tempPath);
+	}
+
+	free(binary);
+}
+
+GLuint compileShader(const char *filename, const char* defines)
 {
 	// read the file
 	ShaderData* shaderData = readShader(filename);
@@ -78,14 +311,34 @@ GLuint compileShader(const char *filename)
 		exit(EXIT_FAILURE);
 	}
 
+	// the defines have to follow the #version line
+	char* body = strchr(shaderData->data, '\n');
+	body = body == NULL ? shaderData->data + shaderData->size : body + 1;
+
+	const GLchar* sources[3] = { shaderData->data, defines, body };
+	GLint lengths[3] = { (GLint)(body - shaderData->data), (GLint)strlen(defines),
+		(GLint)(shaderData->data + shaderData->size - body) };
+
+	// skip the compile when this exact program was built before
+	uint64_t key = shaderCacheKey(shaderData->data, defines);
+	GLuint program = loadCachedProgram(key);
+
+	if (program != 0)
+	{
+		free(shaderData->data);
+		free(shaderData);
+
+		return program;
+	}
+
 	// create the compute shader
 	GLuint compute = glCreateShader(GL_COMPUTE_SHADER);
 
 	// bind the shader to the program
-	GLuint program = glCreateProgram();
+	program = glCreateProgram();
 
 	// read the shader
-	glShaderSource(compute, 1, (const GLchar**)&shaderData->data, &shaderData->size);
+	glShaderSource(compute, 3, sources, lengths);
 
 	// compile the shader
 	glCompileShader(compute);
@@ -112,6 +365,7 @@ GLuint compileShader(const char *filename)
 	glAttachShader(program, compute);
 
 	// check the linker had no errors
+	glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	glLinkProgram(program);
 
 	glGetProgramiv(program, GL_LINK_STATUS, &result);
@@ -127,155 +381,410 @@ GLuint compileShader(const char *filename)
 		exit(EXIT_FAILURE);
 	}
 
+	// the shader is part of the program now
+	glDeleteShader(compute);
+
+	storeCachedProgram(program, key);
+
+	free(shaderData->data);
+	free(shaderData);
+
 	return program;
 }
 
-void waitForGPU()
+static void waitForFence(GLsync fence)
 {
-	GLsync syncObject = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
-	GLenum status = glClientWaitSync(syncObject, GL_SYNC_FLUSH_COMMANDS_BIT, 1000 * 1000 * 1000);
+	GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GPU_TIMEOUT);
 	if (status == GL_WAIT_FAILED || status == GL_TIMEOUT_EXPIRED)
 	{
 		printf("GPU is taking too long.");
 		exit(EXIT_FAILURE);
 	}
+}
+
+// find a display that needs no window system: mesa's surfaceless platform or the first egl device
+static EGLDisplay headlessDisplay()
+{
+	const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+	if (extensions == NULL || getPlatformDisplay == NULL)
+		return EGL_NO_DISPLAY;
+
+	if (strstr(extensions, "EGL_MESA_platform_surfaceless") != NULL)
+	{
+		EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+
+		if (display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL))
+			return display;
+	}
 
-	glMemoryBarrier(GL_ALL_BARRIER_BITS);
-	glDeleteSync(syncObject);
+	if (strstr(extensions, "EGL_EXT_platform_device") != NULL)
+	{
+		PFNEGLQUERYDEVICESEXTPROC queryDevices = (PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
+		EGLDeviceEXT device;
+		EGLint numDevices = 0;
+
+		if (queryDevices != NULL && queryDevices(1, &device, &numDevices) && numDevices > 0)
+		{
+			EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, device, NULL);
+
+			if (display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL))
+				return display;
+		}
+	}
+
+	return EGL_NO_DISPLAY;
 }
 
 void windowlessOpenGL()
 {
-        Display *dpy;
-        Window root;
-        GLint attr[] = { GLX_RGBA, GLX_DEPTH_SIZE, 24, GLX_DOUBLEBUFFER, None };
-        XVisualInfo *vi;
-        GLXContext glc;
-
-        // open the display
-        if (!(dpy = XOpenDisplay(NULL)))
-        {
-                fprintf(stderr, "cannot connect to X server\n\n");
-                exit(1);
-        }
- 
-        // get root window
-        root = DefaultRootWindow(dpy);
-  
-        // get the attr vis
-        if(!(vi = glXChooseVisual(dpy, 0, attr)))
-        {
-                fprintf(stderr, "no appropriate visual found\n\n");
-                exit(1);
-        }
- 
-        // create a context using the root window
-        if (!(glc = glXCreateContext(dpy, vi, NULL, GL_TRUE)))
-        {
-                fprintf(stderr, "failed to create context\n\n");
-                exit(1);
-        }
-
-        glXMakeCurrent(dpy, root, glc);
+	EGLConfig config = EGL_NO_CONFIG_KHR;
+	EGLint contextAttr[] =
+	{
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 4,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+
+	// open the display
+	if ((eglDisplay = headlessDisplay()) == EGL_NO_DISPLAY)
+	{
+		fprintf(stderr, "cannot open a headless EGL display\n\n");
+		exit(1);
+	}
+
+	if (!eglBindAPI(EGL_OPENGL_API))
+	{
+		fprintf(stderr, "EGL cannot bind OpenGL\n\n");
+		exit(1);
+	}
+
+	// compute only needs a context, pick a config only when the driver insists on one
+	if (strstr(eglQueryString(eglDisplay, EGL_EXTENSIONS), "EGL_KHR_no_config_context") == NULL)
+	{
+		EGLint configAttr[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+		EGLint numConfigs = 0;
+
+		if (!eglChooseConfig(eglDisplay, configAttr, &config, 1, &numConfigs) || numConfigs == 0)
+		{
+			fprintf(stderr, "no appropriate config found\n\n");
+			exit(1);
+		}
+	}
+
+	// create a context with no surface behind it
+	if ((eglContext = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT, contextAttr)) == EGL_NO_CONTEXT)
+	{
+		fprintf(stderr, "failed to create context\n\n");
+		exit(1);
+	}
+
+	if (!eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext))
+	{
+		fprintf(stderr, "failed to make the context current\n\n");
+		exit(1);
+	}
 }
 
-void setupGPU(void* data)
+static void allocateBufferSet(GPUBufferSet* set, GLsizeiptr capacity)
+{
+	// immutable storage cannot grow so replace the buffers
+	if (set->capacity != 0)
+		glDeleteBuffers(3, set->buffer);
+
+	glGenBuffers(3, set->buffer);
+
+	// map once and keep the mapping for the life of the buffer
+	for (int i = 0; i < 3; i++)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, set->buffer[i]);
+		glBufferStorage(GL_SHADER_STORAGE_BUFFER, capacity, NULL, GPU_MAP_FLAGS);
+		set->mapped[i] = glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, capacity, GPU_MAP_FLAGS);
+	}
+
+	set->capacity = capacity;
+}
+
+// read back the oldest tile in flight, returns 0 if it is not done and we should not wait
+static int retireOldest(int wait)
+{
+	GPUBufferSet* set = &bufferRing[ringOldest];
+
+	if (!wait)
+	{
+		GLenum status = glClientWaitSync(set->fence, 0, 0);
+
+		if (status == GL_TIMEOUT_EXPIRED)
+			return 0;
+	}
+	else
+		waitForFence(set->fence);
+
+	glDeleteSync(set->fence);
+
+	GPUBatch* batch = set->batch;
+
+	set->batch = NULL;
+	ringOldest = (ringOldest + 1) % GPU_RING_SIZE;
+	ringInFlight--;
+
+	for (int i = 0; i < batch->count; i++)
+	{
+		// copy over the data
+		memcpy(batch->passes[i]->writeBack, (char*)set->mapped[2] + i * set->tileBytes, set->tileBytes);
+
+		// sum up the block and delete excess data
+		blockSum(batch->passes[i]);
+	}
+
+	free(batch);
+
+	return 1;
+}
+
+static void drainGPU()
 {
-	// init glut and OpenGL
-	int argc = 1;
-	char *argv[1] = { (char*)"balance" };
+	while (ringInFlight > 0)
+		retireOldest(1);
+}
+
+// a batch is awaited once the leader of any of its groups has started waiting
+static int batchAwaited(GPUBatch* batch)
+{
+	int awaited = 0;
 
-	glutInit(&argc, argv);
+	for (int i = 0; i < batch->count && !awaited; i++)
+	{
+		SchedPass* pass = batch->passes[i];
+
+		if (pass->leaderWaiting == NULL)
+			continue;
+
+		pthread_mutex_lock(pass->groupLock);
+		awaited = *pass->leaderWaiting;
+		pthread_mutex_unlock(pass->groupLock);
+	}
 
-	glEnable(GL_ARB_compute_shader);
+	return awaited;
+}
+
+void retireAwaitedGPU(void* data)
+{
+	// batches retire in order, so wait up to the newest one somebody is blocked on
+	int awaited = 0;
+
+	for (int i = 0; i < ringInFlight; i++)
+		if (batchAwaited(bufferRing[(ringOldest + i) % GPU_RING_SIZE].batch))
+			awaited = i + 1;
+
+	for (int i = 0; i < awaited; i++)
+		retireOldest(1);
+}
 
+// dimension 0 leaves the matrix size as a uniform
+static GLuint compileVariant(ElementType type, const ShaderVariant* variant, int dimension)
+{
+	char defines[256];
+	int length = snprintf(defines, sizeof(defines), "#define ELEMENT_TYPE %s\n#define GROUP_SIZE %i\n#define MICRO_TILE %i\n",
+		shaderElementType[type], variant->groupSize, variant->microTile);
+
+	if (variant->vectorWidth > 1)
+		length += snprintf(defines + length, sizeof(defines) - length, "#define VECTOR_TYPE %s%i\n#define VECTOR_WIDTH %i\n",
+			shaderVectorType[type], variant->vectorWidth, variant->vectorWidth);
+
+	if (dimension != 0)
+		snprintf(defines + length, sizeof(defines) - length, "#define MATRIX_SIZE %iu\n", dimension);
+
+	return compileShader("mmult.comp", defines);
+}
+
+// time every variant that fits on the batch already bound and keep the fastest, specialised to the size
+static TunedShader* tuneShader(ElementType type, int dimension, int tiles)
+{
+	for (int i = 0; i < numTuned; i++)
+		if (tunedShaders[i].type == type && tunedShaders[i].dimension == dimension)
+			return &tunedShaders[i];
+
+	double bestTime = 0;
+	int best = 0;
+
+	for (int v = 0; v < NUM_VARIANTS; v++)
+	{
+		int blockSize = shaderVariants[v].groupSize * shaderVariants[v].microTile;
+
+		if (dimension % blockSize != 0)
+			continue;
+
+		GLuint program = variantShader[type][v];
+		struct timespec start, end;
+
+		glProgramUniform1ui(program, 0, dimension);
+		glUseProgram(program);
+
+		// the first run pays for any lazy driver work so only time the second
+		// timer queries are not trusted here as software drivers report nothing useful
+		glDispatchCompute(dimension / blockSize, dimension / blockSize, tiles);
+		glFinish();
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		glDispatchCompute(dimension / blockSize, dimension / blockSize, tiles);
+		glFinish();
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+
+		if (bestTime == 0 || elapsed < bestTime)
+		{
+			bestTime = elapsed;
+			best = v;
+		}
+	}
+
+	// forget the oldest shape once the table is full
+	if (numTuned == MAX_TUNED_SHAPES)
+	{
+		glDeleteProgram(tunedShaders[0].program);
+		memmove(&tunedShaders[0], &tunedShaders[1], sizeof(TunedShader) * (MAX_TUNED_SHAPES - 1));
+		numTuned--;
+	}
+
+	TunedShader* tuned = &tunedShaders[numTuned++];
+	tuned->type = type;
+	tuned->dimension = dimension;
+	tuned->blockSize = shaderVariants[best].groupSize * shaderVariants[best].microTile;
+	tuned->program = compileVariant(type, &shaderVariants[best], dimension);
+
+	checkError();
+
+	return tuned;
+}
+
+void setupGPU(void* data)
+{
+	// bind a headless OpenGL context to this thread
 	windowlessOpenGL();
 
-	// init glew
-	GLenum err = glewInit();
+	// compile every variant of the block shader for each element type, the tile size is picked per shape later
+	for (int type = 0; type < numElementTypes; type++)
+	{
+		if (shaderElementType[type] == NULL)
+			continue;
+
+		for (int v = 0; v < NUM_VARIANTS; v++)
+			variantShader[type][v] = compileVariant(type, &shaderVariants[v], 0);
+	}
+
+	numTuned = 0;
 
-	if (err != GLEW_OK)
+	// create the buffer ring up front so tiles never wait on an allocation
+	for (int i = 0; i < GPU_RING_SIZE; i++)
 	{
-		printf("Error: %s", glewGetErrorString(err));
-		exit(EXIT_FAILURE);
+		bufferRing[i].capacity = 0;
+		bufferRing[i].batch = NULL;
+		allocateBufferSet(&bufferRing[i], GPU_TILE_BYTES * GPU_BATCH_SIZE);
 	}
 
-	// compile the balance shader
-	blockMatrixShader = compileShader("mmult.comp");
+	ringNext = 0;
+	ringOldest = 0;
+	ringInFlight = 0;
+	checkError();
 }
 
 void destroyGPU(void* data)
 {
-	// remove the program
-	glDeleteProgram(blockMatrixShader);
+	// finish any tiles still in flight
+	drainGPU();
+
+	// remove the programs
+	for (int type = 0; type < numElementTypes; type++)
+		for (int v = 0; v < NUM_VARIANTS; v++)
+			if (variantShader[type][v] != 0)
+				glDeleteProgram(variantShader[type][v]);
+
+	for (int i = 0; i < numTuned; i++)
+		glDeleteProgram(tunedShaders[i].program);
 
 	// delete the buffers
-	glDeleteBuffers(3, bufferIndex);
+	for (int i = 0; i < GPU_RING_SIZE; i++)
+	{
+		glDeleteBuffers(3, bufferRing[i].buffer);
+		bufferRing[i].capacity = 0;
+	}
+
+	// release the context
+	eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(eglDisplay, eglContext);
+	eglTerminate(eglDisplay);
 }
 
 void multiplyGPU(void* data)
 {
-	SchedPass* sp = (SchedPass*)data;
-
-	int* A = sp->A;
-	int* B = sp->B;
-	pthread_mutex_t* groupLock = sp->groupLock;
-	pthread_cond_t* groupSignal = sp->groupSignal;
-	int* groupProgress = sp->groupProgress;
-
-	int dimension = sp->dimension;
-	int blocksPerGroup = sp->blocksPerGroup;
-	int matrixWidth = blocksPerGroup * dimension;
-	int* writeBack = sp->writeBack;
-	int* outputSpot = sp->outputSpot;
-	
-	// calculate thread size
-	threadSize = dimension / 16;
-	
-	// set the matrix size
-	glProgramUniform1ui(blockMatrixShader, 0, dimension);
+	GPUBatch* batch = (GPUBatch*)data;
+	SchedPass* first = batch->passes[0];
+
+	int dimension = first->dimension;
+
+	GLsizeiptr tileBytes = (GLsizeiptr)elementInfo[first->type].sizeOut * dimension * dimension;
+
+	// read back whatever already finished (batch i - 1) without stalling
+	while (ringInFlight > 0 && retireOldest(0));
+
+	// the ring is full so the oldest batch has to finish first
+	if (ringInFlight == GPU_RING_SIZE)
+		retireOldest(1);
 
-	glGenBuffers(1, &bufferIndex[0]);
+	// take the next buffer set and only grow it if the batches got bigger
+	GPUBufferSet* set = &bufferRing[ringNext];
+	ringNext = (ringNext + 1) % GPU_RING_SIZE;
 
-	// setup the shader input buffer
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, bufferIndex[0]);
-	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint) * dimension * dimension, 0, GL_STATIC_DRAW);
-	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint) * dimension * dimension, A);
+	if (set->capacity < tileBytes * batch->count)
+		allocateBufferSet(set, tileBytes * batch->count);
 
-	glGenBuffers(1, &bufferIndex[1]);
+	// upload the tiles back to back while the gpu is still busy with the previous batch
+	for (int i = 0; i < batch->count; i++)
+	{
+		memcpy((char*)set->mapped[0] + i * tileBytes, batch->passes[i]->A, tileBytes);
+		memcpy((char*)set->mapped[1] + i * tileBytes, batch->passes[i]->B, tileBytes);
+	}
+
+	// setup the shader buffers
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, set->buffer[0]);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, set->buffer[1]);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, set->buffer[2]);
 
-	// setup the shader input buffer
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, bufferIndex[1]);
-	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint) * dimension * dimension, 0, GL_STATIC_DRAW);
-	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint) * dimension * dimension, B);
+	// pick the shader for this shape (tuned on the first batch that has it)
+	TunedShader* shader = tuneShader(first->type, dimension, batch->count);
 
-	glGenBuffers(1, &bufferIndex[2]);
+	// calculate thread size
+	threadSize = dimension / shader->blockSize;
 
-	// setup the shader input buffer
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, bufferIndex[2]);
-	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint) * dimension * dimension, 0, GL_DYNAMIC_DRAW);
-	
 	// setup the balance shader
-	glUseProgram(blockMatrixShader);
+	glUseProgram(shader->program);
 
-	// run the shader
-	glDispatchCompute(threadSize, threadSize, 1);
+	// run the shader, the z axis picks the tile
+	glDispatchCompute(threadSize, threadSize, batch->count);
 
-	// wait for the shader to finish execution
-	waitForGPU();
+	// make the result visible through the mapping and fence it instead of waiting
+	glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+	set->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush();
 
 	// check that dispatch did not cause an error
 	checkError();
 
-	// get the data from the shader
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, bufferIndex[2]);
-	GLint* ssbo = (GLint*)glMapBuffer(GL_SHADER_STORAGE_BUFFER, GL_READ_ONLY);
+	set->batch = batch;
+	set->tileBytes = tileBytes;
+	ringInFlight++;
 
-	// copy over the data
-	memcpy(writeBack, ssbo, sizeof(GLuint) * dimension * dimension);
+	// batches stay in flight until a group leader is left waiting on one
+	retireAwaitedGPU(NULL);
+}
 
-	glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
-	
-	// sum up the block and delete excess data
-	blockSum(data);
+int gpuSupportsType(ElementType type)
+{
+	// the shader only has 32 bit integer and floating point storage
+	return shaderElementType[type] != NULL;
 }
@@ -1,10 +1,27 @@
 #ifndef MMULTGPU_H
 #define MMULTGPU_H
 
+#include "elementType.h"
+#include "scheduler.h"
+
+#define GPU_BATCH_SIZE 8
+
+// tiles of one element type multiplied together in a single dispatch
+typedef struct
+{
+	int count;
+	SchedPass* passes[GPU_BATCH_SIZE];
+} GPUBatch;
+
 void setupGPU(void* data);
 
 void destroyGPU(void* data);
 
 void multiplyGPU(void* data);
 
+// read back the batches in flight that a waiting group leader needs, run on the gpu thread
+void retireAwaitedGPU(void* data);
+
+int gpuSupportsType(ElementType type);
+
 #endif
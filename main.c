@@ -1,8 +1,15 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
 #include <time.h>
 #include "mMultGPU.h"
 #include "scheduler.h"
+#include "outOfCore.h"
+#include "matrixFormats.h"
+#include "matrixPower.h"
+#include "matrixChain.h"
 
 #define NUM_TESTS 10
 #define MATRIX_SIZE 1280
@@ -11,6 +18,908 @@ int mA[MATRIX_SIZE][MATRIX_SIZE];
 int mB[MATRIX_SIZE][MATRIX_SIZE];
 int mC[MATRIX_SIZE][MATRIX_SIZE];
 
+#define SMALL_SIZE 16
+
+// large enough for the tiled paths to sum several tiles into each output tile
+#define CHECK_SIZE 128
+
+static int* newMatrix(int rows, int columns)
+{
+	int* M = (int*)calloc((size_t)rows * columns, sizeof(int));
+
+	if (M == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
+	return M;
+}
+
+// entries in [0, range)
+static int* randomMatrix(int rows, int columns, int range)
+{
+	int* M = newMatrix(rows, columns);
+
+	for (long i = 0; i < (long)rows * columns; i++)
+		M[i] = rand() % range;
+
+	return M;
+}
+
+// C = A * B the obvious way, A is rows x inner and B is inner x columns
+static void naiveProduct(const int* A, const int* B, int* C, int rows, int inner, int columns)
+{
+	for (int i = 0; i < rows; i++)
+		for (int j = 0; j < columns; j++)
+		{
+			int sum = 0;
+
+			for (int k = 0; k < inner; k++)
+				sum += A[i * inner + k] * B[k * columns + j];
+
+			C[i * columns + j] = sum;
+		}
+}
+
+// report the first entry where the scheduler and the naive product differ
+static void compareProduct(const char* name, const int* expected, const int* actual, int rows, int columns)
+{
+	for (int y = 0; y < rows; y++)
+		for (int x = 0; x < columns; x++)
+			if (expected[y * columns + x] != actual[y * columns + x])
+			{
+				printf("%s mismatch at (%i, %i): expected: %i actual: %i\n",
+					name, x, y, expected[y * columns + x], actual[y * columns + x]);
+				return;
+			}
+}
+
+// the entries of M stored as type, the caller frees the copy
+static void* typedMatrix(const int* M, long count, ElementType type)
+{
+	void* typed = malloc((size_t)count * elementInfo[type].sizeA);
+
+	if (typed == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
+	for (long i = 0; i < count; i++)
+		switch (type)
+		{
+			case typeInt32: ((int32_t*)typed)[i] = M[i]; break;
+			case typeFloat32: ((float*)typed)[i] = M[i]; break;
+			case typeFloat64: ((double*)typed)[i] = M[i]; break;
+			case typeInt64: ((int64_t*)typed)[i] = M[i]; break;
+			case typeInt16: ((int16_t*)typed)[i] = M[i]; break;
+			case typeInt8: ((int8_t*)typed)[i] = M[i]; break;
+			case typeUInt8: ((uint8_t*)typed)[i] = M[i]; break;
+			default: break;
+		}
+
+	return typed;
+}
+
+// an output of type read back into ints
+static void untypedMatrix(const void* typed, int* M, long count, ElementType type)
+{
+	for (long i = 0; i < count; i++)
+		switch (type)
+		{
+			case typeInt32: M[i] = ((const int32_t*)typed)[i]; break;
+			case typeFloat32: M[i] = ((const float*)typed)[i]; break;
+			case typeFloat64: M[i] = ((const double*)typed)[i]; break;
+			case typeInt64: M[i] = ((const int64_t*)typed)[i]; break;
+			default: break;
+		}
+}
+
+// tiled and Morton operands are multiplied straight from their tiles
+static void checkLayouts()
+{
+	LayoutType types[2] = { layoutTiled, layoutMorton };
+	const char* names[2] = { "tiled", "Morton" };
+	int* A = randomMatrix(CHECK_SIZE, CHECK_SIZE, 16);
+	int* B = randomMatrix(CHECK_SIZE, CHECK_SIZE, 16);
+	int* C = newMatrix(CHECK_SIZE, CHECK_SIZE);
+
+	naiveProduct(A, B, C, CHECK_SIZE, CHECK_SIZE, CHECK_SIZE);
+
+	for (int i = 0; i < 2; i++)
+	{
+		// 4 x 4 tiles so the Morton order differs from the tiled one
+		MatrixLayout* layout = createLayout(types[i], CHECK_SIZE, CHECK_SIZE / 4, sizeof(int));
+		int* tiledA = (int*)allocateLayoutMatrix(layout, sizeof(int));
+		int* tiledB = (int*)allocateLayoutMatrix(layout, sizeof(int));
+
+		convertToLayout(layout, A, tiledA, sizeof(int));
+		convertToLayout(layout, B, tiledB, sizeof(int));
+
+		Scheduler* scheduler = createTypedScheduler(tiledA, tiledB, CHECK_SIZE, typeInt32);
+		setSchedulerLayout(scheduler, layout, layout);
+		runScheduler(scheduler);
+
+		printf("Checking a product of %s operands.\n", names[i]);
+		compareProduct(names[i], C, (int*)scheduler->dataOut, CHECK_SIZE, CHECK_SIZE);
+
+		deleteScheduler(scheduler);
+		free(tiledA);
+		free(tiledB);
+		deleteLayout(layout);
+	}
+
+	free(A);
+	free(B);
+	free(C);
+}
+
+// every element type on small integers, which all of them multiply exactly
+// the kernels are the best ones the cpu has, run with MMULT_ISA=scalar, avx2 or avxvnni to check the others
+static void checkElementTypes()
+{
+	int* A = randomMatrix(CHECK_SIZE, CHECK_SIZE, 8);
+	int* B = randomMatrix(CHECK_SIZE, CHECK_SIZE, 8);
+	int* C = newMatrix(CHECK_SIZE, CHECK_SIZE);
+	int* actual = newMatrix(CHECK_SIZE, CHECK_SIZE);
+	long count = (long)CHECK_SIZE * CHECK_SIZE;
+
+	// B goes negative for the signed types, A stays in range for uint8
+	for (long i = 0; i < count; i++)
+		B[i] -= 4;
+
+	naiveProduct(A, B, C, CHECK_SIZE, CHECK_SIZE, CHECK_SIZE);
+
+	for (int t = 0; t < numElementTypes; t++)
+	{
+		ElementType type = (ElementType)t;
+
+		// uint8 A is multiplied by an int8 B
+		void* typedA = typedMatrix(A, count, type);
+		void* typedB = typedMatrix(B, count, type == typeUInt8 ? typeInt8 : type);
+
+		Scheduler* scheduler = createTypedScheduler(typedA, typedB, CHECK_SIZE, type);
+		runScheduler(scheduler);
+		untypedMatrix(scheduler->dataOut, actual, count, elementInfo[type].outType);
+
+		printf("Checking a product of %s operands.\n", elementInfo[type].name);
+		compareProduct(elementInfo[type].name, C, actual, CHECK_SIZE, CHECK_SIZE);
+
+		deleteScheduler(scheduler);
+		free(typedA);
+		free(typedB);
+	}
+
+	free(A);
+	free(B);
+	free(C);
+	free(actual);
+}
+
+// int32 operands whose sums leave the int32 range, kept exactly in int64 or clamped into int32
+static void checkAccumulate()
+{
+	int* A = randomMatrix(CHECK_SIZE, CHECK_SIZE, 1 << 21);
+	int* B = randomMatrix(CHECK_SIZE, CHECK_SIZE, 1 << 21);
+	int64_t* C = (int64_t*)malloc(sizeof(int64_t) * CHECK_SIZE * CHECK_SIZE);
+
+	if (C == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
+	for (int i = 0; i < CHECK_SIZE * CHECK_SIZE; i++)
+	{
+		A[i] -= 1 << 20;
+		B[i] -= 1 << 20;
+	}
+
+	for (int i = 0; i < CHECK_SIZE; i++)
+		for (int j = 0; j < CHECK_SIZE; j++)
+		{
+			C[i * CHECK_SIZE + j] = 0;
+
+			for (int k = 0; k < CHECK_SIZE; k++)
+				C[i * CHECK_SIZE + j] += (int64_t)A[i * CHECK_SIZE + k] * B[k * CHECK_SIZE + j];
+		}
+
+	Scheduler* scheduler = createTypedScheduler(A, B, CHECK_SIZE, typeInt32);
+
+	setSchedulerAccumulate(scheduler, accumulateWide);
+	runScheduler(scheduler);
+
+	printf("Checking a product accumulated in int64.\n");
+
+	if (memcmp(scheduler->dataOut, C, sizeof(int64_t) * CHECK_SIZE * CHECK_SIZE) != 0)
+		printf("The wide product does not match the naive one\n");
+
+	setSchedulerAccumulate(scheduler, accumulateSaturate);
+	runScheduler(scheduler);
+
+	printf("Checking a product saturated to int32.\n");
+
+	int* saturated = (int*)scheduler->dataOut;
+
+	for (int i = 0; i < CHECK_SIZE * CHECK_SIZE; i++)
+		if (saturated[i] != (C[i] > INT32_MAX ? INT32_MAX : C[i] < INT32_MIN ? INT32_MIN : C[i]))
+		{
+			printf("The saturated product does not match the naive one\n");
+			break;
+		}
+
+	deleteScheduler(scheduler);
+	free(A);
+	free(B);
+	free(C);
+}
+
+// A stored row major and B tiled in matrix files, multiplied straight out of the mappings
+static void checkMatrixFiles()
+{
+	int* A = randomMatrix(CHECK_SIZE, CHECK_SIZE, 16);
+	int* B = randomMatrix(CHECK_SIZE, CHECK_SIZE, 16);
+	int* C = newMatrix(CHECK_SIZE, CHECK_SIZE);
+	MatrixLayout* layout = createLayout(layoutTiled, CHECK_SIZE, CHECK_SIZE / 4, sizeof(int));
+	int* tiledB = (int*)allocateLayoutMatrix(layout, sizeof(int));
+
+	naiveProduct(A, B, C, CHECK_SIZE, CHECK_SIZE, CHECK_SIZE);
+	convertToLayout(layout, B, tiledB, sizeof(int));
+
+	printf("Checking a product of mapped matrix files.\n");
+
+	if (writeMatrixFile("checkA.matrix", A, typeInt32, CHECK_SIZE, NULL) != 0
+		|| writeMatrixFile("checkB.matrix", tiledB, typeInt32, CHECK_SIZE, layout) != 0)
+		printf("Cannot write the matrix files\n");
+	else
+	{
+		MatrixFile* fileA = openMatrixFile("checkA.matrix");
+		MatrixFile* fileB = openMatrixFile("checkB.matrix");
+
+		if (fileA == NULL || fileB == NULL)
+			printf("Cannot read the matrix files back\n");
+		else
+		{
+			Scheduler* scheduler = createFileScheduler(fileA, fileB);
+			runScheduler(scheduler);
+			compareProduct("matrix file", C, (int*)scheduler->dataOut, CHECK_SIZE, CHECK_SIZE);
+			deleteScheduler(scheduler);
+		}
+
+		if (fileA != NULL)
+			closeMatrixFile(fileA);
+
+		if (fileB != NULL)
+			closeMatrixFile(fileB);
+	}
+
+	remove("checkA.matrix");
+	remove("checkB.matrix");
+	free(tiledB);
+	deleteLayout(layout);
+	free(A);
+	free(B);
+	free(C);
+}
+
+// a product of two matrix files with a budget too small to keep both, so tiles are dropped and read again
+static void checkOutOfCore()
+{
+	int* A = randomMatrix(CHECK_SIZE, CHECK_SIZE, 16);
+	int* B = randomMatrix(CHECK_SIZE, CHECK_SIZE, 16);
+	int* C = newMatrix(CHECK_SIZE, CHECK_SIZE);
+
+	naiveProduct(A, B, C, CHECK_SIZE, CHECK_SIZE, CHECK_SIZE);
+
+	printf("Checking an out of core product.\n");
+
+	if (writeMatrixFile("checkA.matrix", A, typeInt32, CHECK_SIZE, NULL) != 0
+		|| writeMatrixFile("checkB.matrix", B, typeInt32, CHECK_SIZE, NULL) != 0)
+		printf("Cannot write the matrix files\n");
+	else if (multiplyOutOfCore("checkA.matrix", "checkB.matrix", "checkC.matrix", sizeof(int) * CHECK_SIZE * CHECK_SIZE, CHECK_SIZE / 2) != 0)
+		printf("The out of core product failed\n");
+	else
+	{
+		MatrixFile* fileC = openMatrixFile("checkC.matrix");
+
+		if (fileC == NULL)
+			printf("Cannot read the out of core product\n");
+		else
+		{
+			compareProduct("out of core", C, (int*)fileC->data, CHECK_SIZE, CHECK_SIZE);
+			closeMatrixFile(fileC);
+		}
+	}
+
+	remove("checkA.matrix");
+	remove("checkB.matrix");
+	remove("checkC.matrix");
+	free(A);
+	free(B);
+	free(C);
+}
+
+// A round tripped through .npy and B through Matrix Market, read back tiled
+static void checkTextFormats()
+{
+	int* A = randomMatrix(CHECK_SIZE, CHECK_SIZE, 16);
+	int* B = randomMatrix(CHECK_SIZE, CHECK_SIZE, 16);
+	int* C = newMatrix(CHECK_SIZE, CHECK_SIZE);
+
+	naiveProduct(A, B, C, CHECK_SIZE, CHECK_SIZE, CHECK_SIZE);
+
+	printf("Checking a product of .npy and Matrix Market files.\n");
+
+	if (writeNpyFile("checkA.npy", A, typeInt32, CHECK_SIZE, NULL) != 0
+		|| writeMatrixMarketFile("checkB.mtx", B, typeInt32, CHECK_SIZE, NULL) != 0)
+		printf("Cannot write the .npy and Matrix Market files\n");
+	else
+	{
+		MatrixFile* fileA = openNpyFile("checkA.npy", layoutTiled, CHECK_SIZE / 4);
+		MatrixFile* fileB = openMatrixMarketFile("checkB.mtx", typeInt32, layoutTiled, CHECK_SIZE / 4);
+
+		if (fileA == NULL || fileB == NULL)
+			printf("Cannot read the .npy and Matrix Market files back\n");
+		else
+		{
+			Scheduler* scheduler = createFileScheduler(fileA, fileB);
+			runScheduler(scheduler);
+			compareProduct(".npy and Matrix Market", C, (int*)scheduler->dataOut, CHECK_SIZE, CHECK_SIZE);
+			deleteScheduler(scheduler);
+		}
+
+		if (fileA != NULL)
+			closeMatrixFile(fileA);
+
+		if (fileB != NULL)
+			closeMatrixFile(fileB);
+	}
+
+	remove("checkA.npy");
+	remove("checkB.mtx");
+	free(A);
+	free(B);
+	free(C);
+}
+
+// an A with about one entry in eight set, compressed by entry and by block
+static void checkSparse()
+{
+	SparseFormat formats[2] = { sparseCSR, sparseBSR };
+	const char* names[2] = { "CSR", "BSR" };
+	int* A = randomMatrix(CHECK_SIZE, CHECK_SIZE, 16);
+	int* B = randomMatrix(CHECK_SIZE, CHECK_SIZE, 16);
+	int* C = newMatrix(CHECK_SIZE, CHECK_SIZE);
+
+	for (int i = 0; i < CHECK_SIZE * CHECK_SIZE; i++)
+		if (rand() % 8 != 0)
+			A[i] = 0;
+
+	naiveProduct(A, B, C, CHECK_SIZE, CHECK_SIZE, CHECK_SIZE);
+
+	for (int i = 0; i < 2; i++)
+	{
+		SparseMatrix* sparse = createSparseMatrix(A, typeInt32, CHECK_SIZE, NULL, formats[i]);
+		Scheduler* scheduler = createSparseScheduler(sparse, B);
+		runScheduler(scheduler);
+
+		printf("Checking a product of a %s matrix.\n", names[i]);
+		compareProduct(names[i], C, (int*)scheduler->dataOut, CHECK_SIZE, CHECK_SIZE);
+
+		deleteScheduler(scheduler);
+		deleteSparseMatrix(sparse);
+	}
+
+	free(A);
+	free(B);
+	free(C);
+}
+
+// zero 64 x 64 quadrants in both operands, including a whole block row of A so some output tiles get no product
+static void checkZeroTiles()
+{
+	int half = CHECK_SIZE / 2;
+	int* A = randomMatrix(CHECK_SIZE, CHECK_SIZE, 16);
+	int* B = randomMatrix(CHECK_SIZE, CHECK_SIZE, 16);
+	int* C = newMatrix(CHECK_SIZE, CHECK_SIZE);
+
+	for (int y = 0; y < CHECK_SIZE; y++)
+		for (int x = 0; x < CHECK_SIZE; x++)
+		{
+			if (y >= half || x >= half)
+				A[y * CHECK_SIZE + x] = 0;
+
+			if (y >= half && x < half)
+				B[y * CHECK_SIZE + x] = 0;
+		}
+
+	naiveProduct(A, B, C, CHECK_SIZE, CHECK_SIZE, CHECK_SIZE);
+
+	Scheduler* scheduler = createTypedScheduler(A, B, CHECK_SIZE, typeInt32);
+	setSchedulerSkipZeroTiles(scheduler, 1);
+	runScheduler(scheduler);
+
+	printf("Checking a product that skips zero tiles.\n");
+	compareProduct("zero tile", C, (int*)scheduler->dataOut, CHECK_SIZE, CHECK_SIZE);
+
+	deleteScheduler(scheduler);
+	free(A);
+	free(B);
+	free(C);
+}
+
+// a matrix-vector product and a B as wide as the skinny path goes
+static void checkSkinny()
+{
+	int widths[2] = { 1, SKINNY_COLUMNS };
+	int* A = randomMatrix(CHECK_SIZE, CHECK_SIZE, 16);
+	int* B = randomMatrix(CHECK_SIZE, SKINNY_COLUMNS, 16);
+	int* C = newMatrix(CHECK_SIZE, SKINNY_COLUMNS);
+
+	for (int i = 0; i < 2; i++)
+	{
+		naiveProduct(A, B, C, CHECK_SIZE, CHECK_SIZE, widths[i]);
+
+		Scheduler* scheduler = createRectScheduler(A, B, CHECK_SIZE, widths[i], typeInt32);
+		runScheduler(scheduler);
+
+		printf("Checking a product with a %i column wide B.\n", widths[i]);
+		compareProduct("skinny", C, (int*)scheduler->dataOut, CHECK_SIZE, widths[i]);
+
+		deleteScheduler(scheduler);
+	}
+
+	free(A);
+	free(B);
+	free(C);
+}
+
+// C = A * A^T with the lower triangle mirrored, and without where only the upper triangle is written
+static void checkSyrk()
+{
+	int* A = randomMatrix(CHECK_SIZE, CHECK_SIZE, 16);
+	int* transposed = newMatrix(CHECK_SIZE, CHECK_SIZE);
+	int* C = newMatrix(CHECK_SIZE, CHECK_SIZE);
+
+	for (int y = 0; y < CHECK_SIZE; y++)
+		for (int x = 0; x < CHECK_SIZE; x++)
+			transposed[x * CHECK_SIZE + y] = A[y * CHECK_SIZE + x];
+
+	naiveProduct(A, transposed, C, CHECK_SIZE, CHECK_SIZE, CHECK_SIZE);
+
+	Scheduler* mirrored = createSyrkScheduler(A, CHECK_SIZE, typeInt32, 1);
+	runScheduler(mirrored);
+
+	printf("Checking a mirrored symmetric product.\n");
+	compareProduct("mirrored symmetric", C, (int*)mirrored->dataOut, CHECK_SIZE, CHECK_SIZE);
+
+	Scheduler* upper = createSyrkScheduler(A, CHECK_SIZE, typeInt32, 0);
+	runScheduler(upper);
+
+	printf("Checking the upper triangle of a symmetric product.\n");
+
+	int* dataOut = (int*)upper->dataOut;
+	int mismatches = 0;
+
+	for (int y = 0; y < CHECK_SIZE; y++)
+		for (int x = y; x < CHECK_SIZE; x++)
+			mismatches += C[y * CHECK_SIZE + x] != dataOut[y * CHECK_SIZE + x];
+
+	if (mismatches != 0)
+		printf("%i entries of the upper triangle do not match the naive product\n", mismatches);
+
+	deleteScheduler(mirrored);
+	deleteScheduler(upper);
+	free(A);
+	free(transposed);
+	free(C);
+}
+
+// the entries outside each structure hold garbage that the scheduler has to read as zero
+static void checkStructure()
+{
+	MatrixStructure structuresA[2] = { { structureUpper, 0, 0 }, { structureLower, 0, 0 } };
+	MatrixStructure structuresB[2] = { { structureBanded, 5, 40 }, { structureDense, 0, 0 } };
+	const char* names[2] = { "an upper triangular and a banded", "a lower triangular and a dense" };
+	int* A = randomMatrix(CHECK_SIZE, CHECK_SIZE, 16);
+	int* B = randomMatrix(CHECK_SIZE, CHECK_SIZE, 16);
+	int* maskedA = newMatrix(CHECK_SIZE, CHECK_SIZE);
+	int* maskedB = newMatrix(CHECK_SIZE, CHECK_SIZE);
+	int* C = newMatrix(CHECK_SIZE, CHECK_SIZE);
+
+	for (int i = 0; i < 2; i++)
+	{
+		for (int y = 0; y < CHECK_SIZE; y++)
+			for (int x = 0; x < CHECK_SIZE; x++)
+			{
+				maskedA[y * CHECK_SIZE + x] = structureKeeps(&structuresA[i], y, x) ? A[y * CHECK_SIZE + x] : 0;
+				maskedB[y * CHECK_SIZE + x] = structureKeeps(&structuresB[i], y, x) ? B[y * CHECK_SIZE + x] : 0;
+			}
+
+		naiveProduct(maskedA, maskedB, C, CHECK_SIZE, CHECK_SIZE, CHECK_SIZE);
+
+		Scheduler* scheduler = createTypedScheduler(A, B, CHECK_SIZE, typeInt32);
+		setSchedulerStructure(scheduler, &structuresA[i], &structuresB[i]);
+		runScheduler(scheduler);
+
+		printf("Checking a product of %s matrix.\n", names[i]);
+		compareProduct("structured", C, (int*)scheduler->dataOut, CHECK_SIZE, CHECK_SIZE);
+
+		deleteScheduler(scheduler);
+	}
+
+	free(A);
+	free(B);
+	free(maskedA);
+	free(maskedB);
+	free(C);
+}
+
+// GF(2) products through the popcount kernel and through four russians, neither size a whole number of words
+static void checkBits()
+{
+	int sizes[2] = { 100, 300 };
+
+	for (int i = 0; i < 2; i++)
+	{
+		int size = sizes[i];
+		int* A = randomMatrix(size, size, 2);
+		int* B = randomMatrix(size, size, 2);
+		int* C = newMatrix(size, size);
+		int* actual = newMatrix(size, size);
+
+		// the parity of the integer product
+		naiveProduct(A, B, C, size, size, size);
+
+		for (int k = 0; k < size * size; k++)
+			C[k] &= 1;
+
+		BitMatrix* bitA = packBitMatrix(A, size);
+		BitMatrix* bitB = packBitMatrix(B, size);
+		Scheduler* scheduler = createBitScheduler(bitA, bitB);
+		runScheduler(scheduler);
+
+		BitMatrix product = { size, bitA->wordsPerRow, (uint64_t*)scheduler->dataOut };
+		unpackBitMatrix(&product, actual);
+
+		printf("Checking a GF(2) product of size %i.\n", size);
+		compareProduct("GF(2)", C, actual, size, size);
+
+		deleteScheduler(scheduler);
+		deleteBitMatrix(bitA);
+		deleteBitMatrix(bitB);
+		free(A);
+		free(B);
+		free(C);
+		free(actual);
+	}
+}
+
+// min-plus and max-plus on small distances and the boolean product of 0 / 1 entries
+static void checkSemirings()
+{
+	Semiring semirings[3] = { semiringMinPlus, semiringMaxPlus, semiringBoolean };
+	const char* names[3] = { "min-plus", "max-plus", "boolean" };
+	int ranges[3] = { 100, 100, 2 };
+
+	for (int i = 0; i < 3; i++)
+	{
+		int* A = randomMatrix(CHECK_SIZE, CHECK_SIZE, ranges[i]);
+		int* B = randomMatrix(CHECK_SIZE, CHECK_SIZE, ranges[i]);
+		int* C = newMatrix(CHECK_SIZE, CHECK_SIZE);
+
+		for (int y = 0; y < CHECK_SIZE; y++)
+			for (int x = 0; x < CHECK_SIZE; x++)
+				for (int k = 0; k < CHECK_SIZE; k++)
+				{
+					int a = A[y * CHECK_SIZE + k], b = B[k * CHECK_SIZE + x];
+					int* c = &C[y * CHECK_SIZE + x];
+
+					if (semirings[i] == semiringMinPlus)
+						*c = k == 0 || a + b < *c ? a + b : *c;
+					else if (semirings[i] == semiringMaxPlus)
+						*c = k == 0 || a + b > *c ? a + b : *c;
+					else
+						*c |= a & b;
+				}
+
+		Scheduler* scheduler = createTypedScheduler(A, B, CHECK_SIZE, typeInt32);
+		setSchedulerSemiring(scheduler, semirings[i]);
+		runScheduler(scheduler);
+
+		printf("Checking a %s product.\n", names[i]);
+		compareProduct(names[i], C, (int*)scheduler->dataOut, CHECK_SIZE, CHECK_SIZE);
+
+		deleteScheduler(scheduler);
+		free(A);
+		free(B);
+		free(C);
+	}
+}
+
+// residues of a prime near 2^30, whose products only fit in 64 bits
+static void checkModular()
+{
+	uint32_t modulus = 998244353;
+	int* A = newMatrix(CHECK_SIZE, CHECK_SIZE);
+	int* B = newMatrix(CHECK_SIZE, CHECK_SIZE);
+	int* C = newMatrix(CHECK_SIZE, CHECK_SIZE);
+
+	for (int i = 0; i < CHECK_SIZE * CHECK_SIZE; i++)
+	{
+		A[i] = ((uint32_t)rand() << 8 ^ rand()) % modulus;
+		B[i] = ((uint32_t)rand() << 8 ^ rand()) % modulus;
+	}
+
+	for (int y = 0; y < CHECK_SIZE; y++)
+		for (int x = 0; x < CHECK_SIZE; x++)
+		{
+			uint64_t sum = 0;
+
+			for (int k = 0; k < CHECK_SIZE; k++)
+				sum = (sum + (uint64_t)A[y * CHECK_SIZE + k] * B[k * CHECK_SIZE + x]) % modulus;
+
+			C[y * CHECK_SIZE + x] = sum;
+		}
+
+	Scheduler* scheduler = createTypedScheduler(A, B, CHECK_SIZE, typeInt32);
+	setSchedulerModulus(scheduler, modulus);
+	runScheduler(scheduler);
+
+	printf("Checking a product mod %u.\n", modulus);
+	compareProduct("modular", C, (int*)scheduler->dataOut, CHECK_SIZE, CHECK_SIZE);
+
+	deleteScheduler(scheduler);
+	free(A);
+	free(B);
+	free(C);
+}
+
+// A^5 for a size off the 16 element grid, so the power runs on zero padded tiles
+static void checkMatrixPower()
+{
+	int size = 100;
+	int* A = randomMatrix(size, size, 3);
+	int* C = newMatrix(size, size);
+	int* previous = newMatrix(size, size);
+
+	for (int i = 0; i < size * size; i++)
+		A[i] -= 1;
+
+	memcpy(C, A, sizeof(int) * size * size);
+
+	for (int k = 1; k < 5; k++)
+	{
+		memcpy(previous, C, sizeof(int) * size * size);
+		naiveProduct(previous, A, C, size, size, size);
+	}
+
+	int* power = (int*)matrixPower(A, size, typeInt32, 5);
+
+	printf("Checking a matrix power.\n");
+	compareProduct("matrix power", C, power, size, size);
+
+	free(power);
+	free(A);
+	free(C);
+	free(previous);
+}
+
+// four links of sizes that are not whole tiles, multiplied in whichever order is cheapest
+static void checkChain()
+{
+	int dims[5] = { 90, 150, 20, 130, 70 };
+	ChainMatrix matrices[4];
+
+	for (int i = 0; i < 4; i++)
+		matrices[i] = (ChainMatrix){ randomMatrix(dims[i], dims[i + 1], 8), dims[i], dims[i + 1] };
+
+	// multiplied left to right
+	int* C = newMatrix(dims[0], dims[1]);
+	memcpy(C, matrices[0].data, sizeof(int) * dims[0] * dims[1]);
+
+	for (int i = 1; i < 4; i++)
+	{
+		int* next = newMatrix(dims[0], dims[i + 1]);
+		naiveProduct(C, (int*)matrices[i].data, next, dims[0], dims[i], dims[i + 1]);
+		free(C);
+		C = next;
+	}
+
+	int* chain = (int*)multiplyChain(matrices, 4, typeInt32);
+
+	printf("Checking a matrix chain product.\n");
+
+	if (chain == NULL)
+		printf("The matrix chain product failed\n");
+	else
+		compareProduct("matrix chain", C, chain, dims[0], dims[4]);
+
+	for (int i = 0; i < 4; i++)
+		free(matrices[i].data);
+
+	free(chain);
+	free(C);
+}
+
+// scale, bias, ReLU and clamp fused into the write, then a bias and a requantization to int8
+static void checkEpilogues()
+{
+	int* A = randomMatrix(CHECK_SIZE, CHECK_SIZE, 16);
+	int* B = randomMatrix(CHECK_SIZE, CHECK_SIZE, 16);
+	int* C = newMatrix(CHECK_SIZE, CHECK_SIZE);
+	int* expected = newMatrix(CHECK_SIZE, CHECK_SIZE);
+	int* bias = randomMatrix(1, CHECK_SIZE, 200);
+	Epilogue epilogues[2] =
+	{
+		{ epilogueScale | epilogueBias | epilogueRelu | epilogueClamp, 0.5, bias, 0.0, 150.0, 0.0f, 0 },
+		{ epilogueBias | epilogueRequantize, 1.0, bias, 0.0, 0.0, 0.05f, -3 }
+	};
+	const char* names[2] = { "scale, bias, ReLU and clamp", "bias and requantize" };
+
+	// both signs so the ReLU and the int8 range matter
+	for (int i = 0; i < CHECK_SIZE * CHECK_SIZE; i++)
+		A[i] -= 8;
+
+	for (int i = 0; i < CHECK_SIZE; i++)
+		bias[i] -= 100;
+
+	naiveProduct(A, B, C, CHECK_SIZE, CHECK_SIZE, CHECK_SIZE);
+
+	for (int i = 0; i < 2; i++)
+	{
+		const Epilogue* epilogue = &epilogues[i];
+
+		for (int y = 0; y < CHECK_SIZE; y++)
+			for (int x = 0; x < CHECK_SIZE; x++)
+			{
+				int value = C[y * CHECK_SIZE + x];
+
+				if (epilogue->ops & epilogueScale)
+					value = (int)(value * epilogue->scale);
+
+				value += bias[x];
+
+				if (epilogue->ops & epilogueRelu)
+					value = value < 0 ? 0 : value;
+
+				if (epilogue->ops & epilogueClamp)
+					value = value < epilogue->lower ? epilogue->lower : value > epilogue->upper ? epilogue->upper : value;
+
+				if (epilogue->ops & epilogueRequantize)
+				{
+					long quantized = lrintf((float)value * epilogue->requantScale) + epilogue->zeroPoint;
+					value = quantized < -128 ? -128 : quantized > 127 ? 127 : quantized;
+				}
+
+				expected[y * CHECK_SIZE + x] = value;
+			}
+
+		Scheduler* scheduler = createTypedScheduler(A, B, CHECK_SIZE, typeInt32);
+		setSchedulerEpilogue(scheduler, epilogue);
+		runScheduler(scheduler);
+
+		printf("Checking a product with a %s epilogue.\n", names[i]);
+		compareProduct("epilogue", expected, (int*)scheduler->dataOut, CHECK_SIZE, CHECK_SIZE);
+
+		deleteScheduler(scheduler);
+	}
+
+	free(A);
+	free(B);
+	free(C);
+	free(expected);
+	free(bias);
+}
+
+// rank 2 changes to A and then to B folded into the last result instead of recomputing it
+static void checkLowRank()
+{
+	int rank = 2;
+	int* A = randomMatrix(CHECK_SIZE, CHECK_SIZE, 16);
+	int* B = randomMatrix(CHECK_SIZE, CHECK_SIZE, 16);
+	int* C = newMatrix(CHECK_SIZE, CHECK_SIZE);
+	int* U = randomMatrix(CHECK_SIZE, rank, 4);
+	int* V = randomMatrix(rank, CHECK_SIZE, 4);
+	int* delta = newMatrix(CHECK_SIZE, CHECK_SIZE);
+
+	Scheduler* scheduler = createTypedScheduler(A, B, CHECK_SIZE, typeInt32);
+	runScheduler(scheduler);
+
+	naiveProduct(U, V, delta, CHECK_SIZE, rank, CHECK_SIZE);
+
+	for (int i = 0; i < 2; i++)
+	{
+		int* changed = i == 0 ? A : B;
+
+		for (int k = 0; k < CHECK_SIZE * CHECK_SIZE; k++)
+			changed[k] += delta[k];
+
+		updateSchedulerLowRank(scheduler, i == 0, U, V, rank);
+		naiveProduct(A, B, C, CHECK_SIZE, CHECK_SIZE, CHECK_SIZE);
+
+		printf("Checking a rank %i update of %s.\n", rank, i == 0 ? "A" : "B");
+		compareProduct("low rank", C, (int*)scheduler->dataOut, CHECK_SIZE, CHECK_SIZE);
+	}
+
+	deleteScheduler(scheduler);
+	free(A);
+	free(B);
+	free(C);
+	free(U);
+	free(V);
+	free(delta);
+}
+
+// a repeated product comes out of the cache, and one with a changed B must not
+static void checkCache()
+{
+	int* A = randomMatrix(CHECK_SIZE, CHECK_SIZE, 16);
+	int* B = randomMatrix(CHECK_SIZE, CHECK_SIZE, 16);
+	int* C = newMatrix(CHECK_SIZE, CHECK_SIZE);
+	MatrixCache* cache = createMatrixCache(1L << 24, 1);
+	long hits, misses, bytes;
+
+	Scheduler* scheduler = createTypedScheduler(A, B, CHECK_SIZE, typeInt32);
+	setSchedulerCache(scheduler, cache);
+	naiveProduct(A, B, C, CHECK_SIZE, CHECK_SIZE, CHECK_SIZE);
+
+	runScheduler(scheduler);
+	memset(scheduler->dataOut, 0, sizeof(int) * CHECK_SIZE * CHECK_SIZE);
+	runScheduler(scheduler);
+	getCacheStats(cache, &hits, &misses, &bytes);
+
+	printf("Checking a cached product.\n");
+	compareProduct("cached", C, (int*)scheduler->dataOut, CHECK_SIZE, CHECK_SIZE);
+
+	if (hits == 0)
+		printf("The repeated product was not found in the cache\n");
+
+	B[CHECK_SIZE + 1] += 1;
+	naiveProduct(A, B, C, CHECK_SIZE, CHECK_SIZE, CHECK_SIZE);
+	runScheduler(scheduler);
+
+	printf("Checking a product after its operand changed.\n");
+	compareProduct("changed", C, (int*)scheduler->dataOut, CHECK_SIZE, CHECK_SIZE);
+
+	deleteScheduler(scheduler);
+	deleteMatrixCache(cache);
+	free(A);
+	free(B);
+	free(C);
+}
+
+// a changed row of A is also a changed column of A * A^T, so a refresh has to match a full recompute
+static void checkSymmetricRefresh()
+{
+	int A[SMALL_SIZE * SMALL_SIZE];
+	int changed[1] = { SMALL_SIZE / 2 };
+
+	for (int i = 0; i < SMALL_SIZE * SMALL_SIZE; i++)
+		A[i] = rand() % 16;
+
+	Scheduler* refreshed = createSyrkScheduler(A, SMALL_SIZE, typeInt32, 1);
+	runScheduler(refreshed);
+
+	for (int k = 0; k < SMALL_SIZE; k++)
+		A[changed[0] * SMALL_SIZE + k] = rand() % 16;
+
+	setSchedulerDirty(refreshed, changed, 1, NULL, 0);
+	runScheduler(refreshed);
+
+	Scheduler* full = createSyrkScheduler(A, SMALL_SIZE, typeInt32, 1);
+	runScheduler(full);
+
+	printf("Checking a dirty row refresh of a symmetric product.\n");
+
+	if (memcmp(refreshed->dataOut, full->dataOut, sizeof(int) * SMALL_SIZE * SMALL_SIZE) != 0)
+		printf("The refreshed product does not match a full recompute\n");
+
+	deleteScheduler(refreshed);
+	deleteScheduler(full);
+}
+
 int main()
 {
 	// set a random seedn
@@ -69,18 +978,44 @@ int main()
 	printf("The naive implementation takes %f seconds.\n", elapsed / (double)NUM_TESTS);
 
 	printf("Checking the two implementations yield the same values.\n");
+
+	int* dataOut = (int*)scheduler->dataOut;
 	
 	for (int y = 0; y < MATRIX_SIZE; y++)
 		for (int x = 0; x < MATRIX_SIZE; x++)
-			if (mC[y][x] != scheduler->dataOut[y * MATRIX_SIZE + x])
+			if (mC[y][x] != dataOut[y * MATRIX_SIZE + x])
 			{
 				printf("Mismatch at (%i, %i): expected: %i actual: %i\n",
-					x, y, mC[y][x], scheduler->dataOut[y * MATRIX_SIZE + x]);
+					x, y, mC[y][x], dataOut[y * MATRIX_SIZE + x]);
 			}
 
 	
 	// delete the scheduler
 	deleteScheduler(scheduler);
 
+	checkLayouts();
+	checkElementTypes();
+	checkAccumulate();
+	checkMatrixFiles();
+	checkOutOfCore();
+	checkTextFormats();
+	checkSparse();
+	checkZeroTiles();
+	checkSkinny();
+	checkSyrk();
+	checkStructure();
+	checkBits();
+	checkSemirings();
+	checkModular();
+	checkMatrixPower();
+	checkChain();
+	checkEpilogues();
+	checkLowRank();
+	checkSymmetricRefresh();
+	checkCache();
+
 	printf("Finished Comparison\n");
+
+	// the checks start the gpu again
+	killSchedulerGPU();
 }
@@ -0,0 +1,288 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "matrixCache.h"
+
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+typedef struct
+{
+	CacheKey key;
+	void* data;
+	MatrixLayout* layout;
+	long bytes;
+	int pins; // runs still reading the data, it cannot be evicted until they finish
+	long lastUse;
+} CacheEntry;
+
+struct MatrixCache
+{
+	CacheEntry* entries;
+	int count, capacity;
+	long budget, used;
+	int cacheResults;
+	long clock;
+	long hits, misses;
+	pthread_mutex_t lock;
+};
+
+static inline uint64_t rotateLeft(uint64_t x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const unsigned char* p)
+{
+	uint64_t value;
+	memcpy(&value, p, sizeof(value));
+
+	return value;
+}
+
+static inline uint64_t read32(const unsigned char* p)
+{
+	uint32_t value;
+	memcpy(&value, p, sizeof(value));
+
+	return value;
+}
+
+static inline uint64_t hashRound(uint64_t accumulator, uint64_t input)
+{
+	accumulator += input * PRIME64_2;
+	accumulator = rotateLeft(accumulator, 31);
+
+	return accumulator * PRIME64_1;
+}
+
+static inline uint64_t hashMerge(uint64_t hash, uint64_t accumulator)
+{
+	hash ^= hashRound(0, accumulator);
+
+	return hash * PRIME64_1 + PRIME64_4;
+}
+
+uint64_t hashContents(const void* data, size_t length, uint64_t seed)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	const unsigned char* end = p + length;
+	uint64_t hash;
+
+	// four independent lanes over 32 byte stripes
+	if (length >= 32)
+	{
+		uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+		uint64_t v2 = seed + PRIME64_2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - PRIME64_1;
+
+		do
+		{
+			v1 = hashRound(v1, read64(p));
+			v2 = hashRound(v2, read64(p + 8));
+			v3 = hashRound(v3, read64(p + 16));
+			v4 = hashRound(v4, read64(p + 24));
+			p += 32;
+		} while (p + 32 <= end);
+
+		hash = rotateLeft(v1, 1) + rotateLeft(v2, 7) + rotateLeft(v3, 12) + rotateLeft(v4, 18);
+		hash = hashMerge(hash, v1);
+		hash = hashMerge(hash, v2);
+		hash = hashMerge(hash, v3);
+		hash = hashMerge(hash, v4);
+	}
+	else
+		hash = seed + PRIME64_5;
+
+	hash += length;
+
+	// the tail
+	for (; p + 8 <= end; p += 8)
+		hash = rotateLeft(hash ^ hashRound(0, read64(p)), 27) * PRIME64_1 + PRIME64_4;
+
+	if (p + 4 <= end)
+	{
+		hash = rotateLeft(hash ^ (read32(p) * PRIME64_1), 23) * PRIME64_2 + PRIME64_3;
+		p += 4;
+	}
+
+	for (; p < end; p++)
+		hash = rotateLeft(hash ^ (*p * PRIME64_5), 11) * PRIME64_1;
+
+	hash ^= hash >> 33;
+	hash *= PRIME64_2;
+	hash ^= hash >> 29;
+	hash *= PRIME64_3;
+	hash ^= hash >> 32;
+
+	return hash;
+}
+
+MatrixCache* createMatrixCache(long memoryBudget, int cacheResults)
+{
+	MatrixCache* cache = (MatrixCache*)calloc(1, sizeof(MatrixCache));
+
+	if (cache == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
+	cache->budget = memoryBudget;
+	cache->cacheResults = cacheResults;
+
+	if (pthread_mutex_init(&cache->lock, NULL) != 0)
+	{
+		printf("Cannot create mutex\n");
+		exit(-1);
+	}
+
+	return cache;
+}
+
+static void dropEntry(MatrixCache* cache, int index)
+{
+	CacheEntry* entry = &cache->entries[index];
+
+	free(entry->data);
+
+	if (entry->layout != NULL)
+		deleteLayout(entry->layout);
+
+	cache->used -= entry->bytes;
+	cache->entries[index] = cache->entries[--cache->count];
+}
+
+void deleteMatrixCache(MatrixCache* cache)
+{
+	while (cache->count > 0)
+		dropEntry(cache, cache->count - 1);
+
+	pthread_mutex_destroy(&cache->lock);
+	free(cache->entries);
+	free(cache);
+}
+
+int cachesResults(MatrixCache* cache)
+{
+	return cache->cacheResults;
+}
+
+static int findEntry(MatrixCache* cache, const CacheKey* key)
+{
+	for (int i = 0; i < cache->count; i++)
+		if (memcmp(&cache->entries[i].key, key, sizeof(CacheKey)) == 0)
+			return i;
+
+	return -1;
+}
+
+void* lookupCache(MatrixCache* cache, const CacheKey* key, MatrixLayout** layout)
+{
+	void* data = NULL;
+
+	pthread_mutex_lock(&cache->lock);
+
+	int index = findEntry(cache, key);
+
+	if (index >= 0)
+	{
+		CacheEntry* entry = &cache->entries[index];
+		entry->pins++;
+		entry->lastUse = ++cache->clock;
+		data = entry->data;
+
+		if (layout != NULL)
+			*layout = entry->layout;
+
+		cache->hits++;
+	}
+	else
+		cache->misses++;
+
+	pthread_mutex_unlock(&cache->lock);
+
+	return data;
+}
+
+int storeCache(MatrixCache* cache, const CacheKey* key, void* data, long bytes, MatrixLayout* layout)
+{
+	pthread_mutex_lock(&cache->lock);
+
+	if (bytes > cache->budget || findEntry(cache, key) >= 0)
+	{
+		pthread_mutex_unlock(&cache->lock);
+		return 0;
+	}
+
+	// make room from the least recently used end, entries in use stay
+	while (cache->used + bytes > cache->budget)
+	{
+		int victim = -1;
+
+		for (int i = 0; i < cache->count; i++)
+			if (cache->entries[i].pins == 0 && (victim < 0 || cache->entries[i].lastUse < cache->entries[victim].lastUse))
+				victim = i;
+
+		if (victim < 0)
+		{
+			pthread_mutex_unlock(&cache->lock);
+			return 0;
+		}
+
+		dropEntry(cache, victim);
+	}
+
+	if (cache->count == cache->capacity)
+	{
+		cache->capacity = cache->capacity == 0 ? 16 : cache->capacity * 2;
+		cache->entries = (CacheEntry*)realloc(cache->entries, sizeof(CacheEntry) * cache->capacity);
+
+		if (cache->entries == NULL)
+		{
+			printf("Out of memory\n");
+			exit(-1);
+		}
+	}
+
+	CacheEntry* entry = &cache->entries[cache->count++];
+	entry->key = *key;
+	entry->data = data;
+	entry->layout = layout;
+	entry->bytes = bytes;
+	entry->pins = 1;
+	entry->lastUse = ++cache->clock;
+	cache->used += bytes;
+
+	pthread_mutex_unlock(&cache->lock);
+
+	return 1;
+}
+
+void releaseCache(MatrixCache* cache, const void* data)
+{
+	pthread_mutex_lock(&cache->lock);
+
+	for (int i = 0; i < cache->count; i++)
+		if (cache->entries[i].data == data)
+			cache->entries[i].pins--;
+
+	pthread_mutex_unlock(&cache->lock);
+}
+
+void getCacheStats(MatrixCache* cache, long* hits, long* misses, long* bytes)
+{
+	pthread_mutex_lock(&cache->lock);
+
+	*hits = cache->hits;
+	*misses = cache->misses;
+	*bytes = cache->used;
+
+	pthread_mutex_unlock(&cache->lock);
+}
@@ -0,0 +1,47 @@
+#ifndef MATRIX_CACHE_H
+#define MATRIX_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "matrixLayout.h"
+
+typedef enum
+{
+	cachedResult = 1, // a whole product in the scheduler's output format
+	cachedPanels // B packed into the scheduler's tiles
+} CachedKind;
+
+// operands are told apart by the hash of their contents, two different matrices with the same hash would be confused
+typedef struct
+{
+	uint64_t kind;
+	uint64_t hashA, hashB;
+	uint64_t hashSettings; // shape, type and everything else the stored data depends on
+} CacheKey;
+
+typedef struct MatrixCache MatrixCache;
+
+// holds at most memoryBudget bytes, the least recently used entries go first, results are only kept with cacheResults
+// one cache can be shared by any number of schedulers
+MatrixCache* createMatrixCache(long memoryBudget, int cacheResults);
+
+void deleteMatrixCache(MatrixCache* cache);
+
+int cachesResults(MatrixCache* cache);
+
+// xxHash64 of the bytes
+uint64_t hashContents(const void* data, size_t length, uint64_t seed);
+
+// the entry's data, pinned until released, or null on a miss, layout gets the entry's layout
+void* lookupCache(MatrixCache* cache, const CacheKey* key, MatrixLayout** layout);
+
+// takes over data and layout (which may be null) and leaves the entry pinned, returns 0 and keeps nothing
+// when the entry cannot fit the budget or is already there
+int storeCache(MatrixCache* cache, const CacheKey* key, void* data, long bytes, MatrixLayout* layout);
+
+void releaseCache(MatrixCache* cache, const void* data);
+
+void getCacheStats(MatrixCache* cache, long* hits, long* misses, long* bytes);
+
+#endif
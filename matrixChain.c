@@ -0,0 +1,419 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+
+#include "matrixChain.h"
+#include "scheduler.h"
+#include "mMultCPU.h"
+#include "threadPool.h"
+
+#define CHAIN_BLOCK_SIZE 64 // the scheduler's tile size, every operand is padded to a multiple of it
+
+// intermediates are handed back once consumed and reused by later products that fit in them
+typedef struct
+{
+	void* data;
+	size_t bytes;
+	int inUse;
+} PooledBuffer;
+
+typedef struct
+{
+	PooledBuffer* buffers;
+	int count, capacity;
+} BufferPool;
+
+typedef struct ChainNode ChainNode;
+
+// a link of the chain or the product of two subchains, stored zero padded to whole tiles
+struct ChainNode
+{
+	ChainNode* left;
+	ChainNode* right;
+	int rows, columns;
+	int paddedRows, paddedColumns;
+	void* data;
+	int pendingJobs; // tile products still running, guarded by the run's lock
+	int started, done;
+};
+
+typedef struct
+{
+	pthread_mutex_t lock;
+	pthread_cond_t finished;
+} ChainRun;
+
+typedef struct
+{
+	SchedPass* pass;
+	ChainNode* node;
+	ChainRun* run;
+} ChainJob;
+
+static int padToTile(int size)
+{
+	return (size + CHAIN_BLOCK_SIZE - 1) / CHAIN_BLOCK_SIZE * CHAIN_BLOCK_SIZE;
+}
+
+static void* acquireBuffer(BufferPool* pool, size_t bytes)
+{
+	PooledBuffer* best = NULL;
+
+	// the smallest free buffer that is large enough
+	for (int i = 0; i < pool->count; i++)
+		if (!pool->buffers[i].inUse && pool->buffers[i].bytes >= bytes && (best == NULL || pool->buffers[i].bytes < best->bytes))
+			best = &pool->buffers[i];
+
+	if (best == NULL)
+	{
+		if (pool->count == pool->capacity)
+		{
+			pool->capacity = pool->capacity == 0 ? 8 : pool->capacity * 2;
+			pool->buffers = (PooledBuffer*)realloc(pool->buffers, sizeof(PooledBuffer) * pool->capacity);
+
+			if (pool->buffers == NULL)
+			{
+				printf("Out of memory\n");
+				exit(-1);
+			}
+		}
+
+		best = &pool->buffers[pool->count];
+		best->bytes = bytes;
+		best->data = malloc(bytes);
+
+		if (best->data == NULL)
+		{
+			printf("Out of memory\n");
+			exit(-1);
+		}
+
+		pool->count++;
+	}
+
+	best->inUse = 1;
+
+	return best->data;
+}
+
+static void releaseBuffer(BufferPool* pool, void* data)
+{
+	for (int i = 0; i < pool->count; i++)
+		if (pool->buffers[i].data == data)
+			pool->buffers[i].inUse = 0;
+}
+
+static void deleteBufferPool(BufferPool* pool)
+{
+	for (int i = 0; i < pool->count; i++)
+		free(pool->buffers[i].data);
+
+	free(pool->buffers);
+}
+
+long chainOrder(const int* dims, int count, int* split)
+{
+	long* cost = (long*)calloc((size_t)count * count, sizeof(long));
+
+	if (cost == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
+	for (int i = 0; i < count; i++)
+		split[i * count + i] = i;
+
+	// cheapest order of every run of length matrices, built from the shorter runs
+	for (int length = 2; length <= count; length++)
+	{
+		for (int i = 0; i + length <= count; i++)
+		{
+			int j = i + length - 1;
+			cost[i * count + j] = LONG_MAX;
+
+			for (int s = i; s < j; s++)
+			{
+				long c = cost[i * count + s] + cost[(s + 1) * count + j] + (long)dims[i] * dims[s + 1] * dims[j + 1];
+
+				if (c < cost[i * count + j])
+				{
+					cost[i * count + j] = c;
+					split[i * count + j] = s;
+				}
+			}
+		}
+	}
+
+	long best = cost[count - 1];
+	free(cost);
+
+	return best;
+}
+
+static ChainNode* buildChainTree(ChainNode* nodes, int* used, const int* split, const int* dims, int count, int i, int j)
+{
+	ChainNode* node = &nodes[(*used)++];
+	memset(node, 0, sizeof(ChainNode));
+
+	node->rows = dims[i];
+	node->columns = dims[j + 1];
+	node->paddedRows = padToTile(node->rows);
+	node->paddedColumns = padToTile(node->columns);
+
+	if (i != j)
+	{
+		node->left = buildChainTree(nodes, used, split, dims, count, i, split[i * count + j]);
+		node->right = buildChainTree(nodes, used, split, dims, count, split[i * count + j] + 1, j);
+	}
+
+	return node;
+}
+
+static void multiplyChainTile(void* data)
+{
+	ChainJob* job = (ChainJob*)data;
+	ChainRun* run = job->run;
+
+	multiplyCPU(job->pass);
+
+	pthread_mutex_lock(&run->lock);
+
+	if (--job->node->pendingJobs == 0)
+		pthread_cond_signal(&run->finished);
+
+	pthread_mutex_unlock(&run->lock);
+
+	free(job);
+}
+
+static void* copyTile(const ChainNode* node, int elementSize, int row, int col)
+{
+	char* tile = (char*)malloc((size_t)elementSize * CHAIN_BLOCK_SIZE * CHAIN_BLOCK_SIZE);
+
+	if (tile == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
+	for (int y = 0; y < CHAIN_BLOCK_SIZE; y++)
+		memcpy(&tile[(long)y * CHAIN_BLOCK_SIZE * elementSize], &((char*)node->data)[((long)(row + y) * node->paddedColumns + col) * elementSize],
+			(size_t)elementSize * CHAIN_BLOCK_SIZE);
+
+	return tile;
+}
+
+// queue every tile product of a node, a group's leader waits on its members so each group goes in back to back
+static void startChainNode(ThreadPool* pool, ChainRun* run, ChainNode* node, ElementType type)
+{
+	int elementSize = elementInfo[type].sizeA;
+	int groupSize = node->left->paddedColumns / CHAIN_BLOCK_SIZE;
+
+	node->pendingJobs = node->paddedRows / CHAIN_BLOCK_SIZE * (node->paddedColumns / CHAIN_BLOCK_SIZE) * groupSize;
+	node->started = 1;
+
+	for (int row = 0; row < node->paddedRows; row += CHAIN_BLOCK_SIZE)
+	{
+		for (int col = 0; col < node->paddedColumns; col += CHAIN_BLOCK_SIZE)
+		{
+			char* dataC = (char*)malloc((size_t)elementSize * CHAIN_BLOCK_SIZE * CHAIN_BLOCK_SIZE * groupSize);
+			int* groupProgress = (int*)malloc(sizeof(int));
+			pthread_mutex_t* groupLock = (pthread_mutex_t*)malloc(sizeof(pthread_mutex_t));
+			pthread_cond_t* groupSignal = (pthread_cond_t*)malloc(sizeof(pthread_cond_t));
+
+			if (dataC == NULL || groupProgress == NULL || groupLock == NULL || groupSignal == NULL)
+			{
+				printf("Out of memory\n");
+				exit(-1);
+			}
+
+			*groupProgress = 0;
+
+			if (pthread_mutex_init(groupLock, NULL) != 0 || pthread_cond_init(groupSignal, NULL) != 0)
+			{
+				printf("Cannot create mutex\n");
+				exit(-1);
+			}
+
+			for (int k = 0; k < groupSize; k++)
+			{
+				// zeroed so fields the chain has no use for stay unset
+				SchedPass* pass = (SchedPass*)calloc(1, sizeof(SchedPass));
+				ChainJob* job = (ChainJob*)malloc(sizeof(ChainJob));
+
+				if (pass == NULL || job == NULL)
+				{
+					printf("Out of memory\n");
+					exit(-1);
+				}
+
+				pass->groupID = 0;
+				pass->localID = k;
+				pass->groupProgress = groupProgress;
+				pass->leaderWaiting = NULL;
+				pass->groupLock = groupLock;
+				pass->groupSignal = groupSignal;
+				pass->type = type;
+				pass->accumulate = accumulateNative;
+				pass->semiring = semiringArithmetic;
+				pass->modulus = NULL;
+				pass->epilogue = NULL;
+				pass->A = copyTile(node->left, elementSize, row, k * CHAIN_BLOCK_SIZE);
+				pass->B = copyTile(node->right, elementSize, k * CHAIN_BLOCK_SIZE, col);
+				pass->ownsA = 1;
+				pass->ownsB = 1;
+				pass->blocksPerGroup = groupSize;
+				pass->outputWidth = node->paddedColumns;
+				pass->dimension = CHAIN_BLOCK_SIZE;
+				pass->writeBack = &dataC[(long)k * CHAIN_BLOCK_SIZE * CHAIN_BLOCK_SIZE * elementSize];
+				pass->outputSpot = &((char*)node->data)[((long)row * node->paddedColumns + col) * elementSize];
+				pass->outputColumn = col;
+
+				job->pass = pass;
+				job->node = node;
+				job->run = run;
+
+				while (addJob(pool, multiplyChainTile, job) == queueFull);
+			}
+		}
+	}
+}
+
+void* multiplyChain(const ChainMatrix* matrices, int count, ElementType type)
+{
+	if (elementInfo[type].outType != type || count < 1)
+	{
+		printf("Cannot multiply a chain of %i %s matrices\n", count, elementInfo[type].name);
+		exit(-1);
+	}
+
+	int* dims = (int*)malloc(sizeof(int) * (count + 1));
+	int* split = (int*)malloc(sizeof(int) * count * count);
+	ChainNode* nodes = (ChainNode*)malloc(sizeof(ChainNode) * (2 * count - 1));
+
+	if (dims == NULL || split == NULL || nodes == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		if (i > 0 && matrices[i].rows != matrices[i - 1].columns)
+		{
+			free(dims);
+			free(split);
+			free(nodes);
+			return NULL;
+		}
+
+		dims[i] = matrices[i].rows;
+		dims[i + 1] = matrices[i].columns;
+	}
+
+	chainOrder(dims, count, split);
+
+	int used = 0;
+	ChainNode* root = buildChainTree(nodes, &used, split, dims, count, 0, count - 1);
+
+	// the links are padded into pooled buffers so their space serves the intermediates once consumed
+	int elementSize = elementInfo[type].sizeA;
+	BufferPool buffers = { NULL, 0, 0 };
+	int link = 0;
+
+	for (int n = 0; n < used; n++)
+	{
+		ChainNode* node = &nodes[n];
+
+		// the tree is built depth first so the leaves come in chain order
+		if (node->left != NULL)
+			continue;
+
+		const ChainMatrix* matrix = &matrices[link++];
+		size_t rowBytes = (size_t)elementSize * node->paddedColumns;
+		node->data = acquireBuffer(&buffers, rowBytes * node->paddedRows);
+		memset(node->data, 0, rowBytes * node->paddedRows);
+
+		for (int y = 0; y < node->rows; y++)
+			memcpy(&((char*)node->data)[y * rowBytes], &((char*)matrix->data)[(size_t)y * matrix->columns * elementSize],
+				(size_t)elementSize * matrix->columns);
+
+		node->started = 1;
+		node->done = 1;
+	}
+
+	ThreadPool* pool = createThreadPool(MAX_CPU_THREADS, MAX_CPU_THREADS);
+	ChainRun run;
+
+	if (pthread_mutex_init(&run.lock, NULL) != 0 || pthread_cond_init(&run.finished, NULL) != 0)
+	{
+		printf("Cannot create mutex\n");
+		exit(-1);
+	}
+
+	// start every product whose factors are ready, then retire products as they finish
+	while (!root->done)
+	{
+		for (int n = 0; n < used; n++)
+		{
+			ChainNode* node = &nodes[n];
+
+			if (!node->started && node->left->done && node->right->done)
+			{
+				node->data = acquireBuffer(&buffers, (size_t)elementSize * node->paddedRows * node->paddedColumns);
+				startChainNode(pool, &run, node, type);
+			}
+		}
+
+		int retired = 0;
+		pthread_mutex_lock(&run.lock);
+
+		while (!retired)
+		{
+			for (int n = 0; n < used; n++)
+			{
+				ChainNode* node = &nodes[n];
+
+				if (node->started && !node->done && node->pendingJobs == 0)
+				{
+					node->done = 1;
+					releaseBuffer(&buffers, node->left->data);
+					releaseBuffer(&buffers, node->right->data);
+					retired = 1;
+				}
+			}
+
+			if (!retired)
+				pthread_cond_wait(&run.finished, &run.lock);
+		}
+
+		pthread_mutex_unlock(&run.lock);
+	}
+
+	destroyThreadPool(pool, shutdown);
+	pthread_mutex_destroy(&run.lock);
+	pthread_cond_destroy(&run.finished);
+
+	// strip the padding
+	size_t rowBytes = (size_t)elementSize * root->columns;
+	char* result = (char*)malloc(rowBytes * root->rows);
+
+	if (result == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
+	for (int y = 0; y < root->rows; y++)
+		memcpy(&result[y * rowBytes], &((char*)root->data)[(size_t)y * root->paddedColumns * elementSize], rowBytes);
+
+	deleteBufferPool(&buffers);
+	free(dims);
+	free(split);
+	free(nodes);
+
+	return result;
+}
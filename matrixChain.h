@@ -0,0 +1,22 @@
+#ifndef MATRIX_CHAIN_H
+#define MATRIX_CHAIN_H
+
+#include "elementType.h"
+
+// one row major link of a chain
+typedef struct
+{
+	void* data;
+	int rows, columns;
+} ChainMatrix;
+
+// matrix i of the chain is dims[i] x dims[i + 1], split[i * count + j] gets the last matrix of the left
+// factor of the product i..j, returns the multiply-adds of the cheapest order
+long chainOrder(const int* dims, int count, int* split);
+
+// the product of count matrices in the cheapest order, the type has to be its own accumulator type
+// subproducts that do not depend on each other run at the same time on the cpu
+// returns a row major matrix the caller frees, null when the shapes do not chain
+void* multiplyChain(const ChainMatrix* matrices, int count, ElementType type);
+
+#endif
@@ -0,0 +1,200 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "matrixFile.h"
+
+static uint64_t payloadBytes(ElementType type, int dimension, MatrixLayout* layout)
+{
+	long elements = layout == NULL ? (long)dimension * dimension : layoutSize(layout);
+
+	return (uint64_t)elementInfo[type].sizeA * elements;
+}
+
+// write all of a buffer, retrying short writes
+static int writeAll(int fd, const void* data, size_t size)
+{
+	const char* bytes = (const char*)data;
+
+	while (size > 0)
+	{
+		ssize_t written = write(fd, bytes, size);
+
+		if (written < 0)
+			return -1;
+
+		bytes += written;
+		size -= written;
+	}
+
+	return 0;
+}
+
+void fillMatrixHeader(MatrixFileHeader* header, ElementType type, int dimension, MatrixLayout* layout)
+{
+	memset(header, 0, sizeof(MatrixFileHeader));
+	memcpy(header->magic, MATRIX_FILE_MAGIC, sizeof(header->magic));
+	header->version = MATRIX_FILE_VERSION;
+	header->elementType = type;
+	header->rows = dimension;
+	header->cols = dimension;
+	header->layout = layout == NULL ? layoutRowMajor : layout->type;
+	header->tileSize = layout == NULL ? dimension : layout->tileSize;
+	header->alignment = MATRIX_FILE_ALIGNMENT;
+	header->payloadOffset = (sizeof(MatrixFileHeader) + MATRIX_FILE_ALIGNMENT - 1) / MATRIX_FILE_ALIGNMENT * MATRIX_FILE_ALIGNMENT;
+	header->payloadSize = payloadBytes(type, dimension, layout);
+}
+
+int createMatrixFile(const char* path, ElementType type, int dimension, MatrixLayout* layout, MatrixFileHeader* header)
+{
+	char padding[MATRIX_FILE_ALIGNMENT] = { 0 };
+
+	if (layout != NULL && layout->type == layoutRowMajor)
+		layout = NULL;
+
+	fillMatrixHeader(header, type, dimension, layout);
+
+	int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+	if (fd < 0)
+	{
+		printf("Cannot create %s\n", path);
+		return -1;
+	}
+
+	// size the file up front, the payload reads back as zeros until written
+	if (writeAll(fd, header, sizeof(MatrixFileHeader)) != 0
+		|| writeAll(fd, padding, header->payloadOffset - sizeof(MatrixFileHeader)) != 0
+		|| ftruncate(fd, header->payloadOffset + header->payloadSize) != 0)
+	{
+		printf("Cannot write %s\n", path);
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int writeMatrixFile(const char* path, const void* data, ElementType type, int dimension, MatrixLayout* layout)
+{
+	MatrixFileHeader header;
+	int fd = createMatrixFile(path, type, dimension, layout, &header);
+
+	if (fd < 0)
+		return -1;
+
+	if (writeAll(fd, data, header.payloadSize) != 0)
+	{
+		printf("Cannot write %s\n", path);
+		close(fd);
+		return -1;
+	}
+
+	return close(fd);
+}
+
+int readMatrixHeader(int fd, MatrixFileHeader* header, MatrixLayout** layout)
+{
+	struct stat info;
+
+	*layout = NULL;
+
+	if (fstat(fd, &info) != 0 || pread(fd, header, sizeof(MatrixFileHeader), 0) != sizeof(MatrixFileHeader)
+		|| memcmp(header->magic, MATRIX_FILE_MAGIC, sizeof(header->magic)) != 0 || header->version != MATRIX_FILE_VERSION)
+		return -1;
+
+	// the scheduler only multiplies square matrices
+	if (header->elementType >= numElementTypes || header->layout > layoutMorton || header->rows != header->cols
+		|| header->rows == 0 || header->rows > 0x7fffffff || header->alignment == 0 || header->tileSize == 0
+		|| (header->layout != layoutRowMajor && header->tileSize > header->rows) || header->payloadOffset % header->alignment != 0
+		|| header->payloadOffset > (uint64_t)info.st_size || header->payloadSize > (uint64_t)info.st_size - header->payloadOffset)
+		return -1;
+
+	if (header->layout != layoutRowMajor)
+		*layout = createLayout((LayoutType)header->layout, (int)header->rows, header->tileSize, elementInfo[header->elementType].sizeA);
+
+	if (payloadBytes((ElementType)header->elementType, (int)header->rows, *layout) != header->payloadSize)
+	{
+		if (*layout != NULL)
+			deleteLayout(*layout);
+
+		*layout = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+MatrixFile* openMatrixFile(const char* path)
+{
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0)
+	{
+		printf("Cannot open %s\n", path);
+		return NULL;
+	}
+
+	MatrixFileHeader header;
+	MatrixLayout* layout;
+
+	if (readMatrixHeader(fd, &header, &layout) != 0)
+	{
+		printf("%s is not a valid matrix file\n", path);
+		close(fd);
+		return NULL;
+	}
+
+	MatrixFile* file = (MatrixFile*)malloc(sizeof(MatrixFile));
+
+	if (file == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
+	file->header = header;
+	file->mapping = NULL;
+	file->allocation = NULL;
+	file->type = (ElementType)header.elementType;
+	file->dimension = (int)header.rows;
+	file->layout = layout;
+
+	// map the whole file so the page aligned mapping keeps the payload aligned too
+	file->mappingSize = header.payloadOffset + header.payloadSize;
+	file->mapping = mmap(NULL, file->mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+
+	// the mapping holds its own reference to the file
+	close(fd);
+
+	if (file->mapping == MAP_FAILED)
+	{
+		printf("Cannot map %s\n", path);
+		file->mapping = NULL;
+		closeMatrixFile(file);
+		return NULL;
+	}
+
+	file->data = (char*)file->mapping + header.payloadOffset;
+
+	// tiles are read in scheduler order rather than file order
+	madvise(file->mapping, file->mappingSize, MADV_WILLNEED);
+
+	return file;
+}
+
+void closeMatrixFile(MatrixFile* file)
+{
+	if (file->mapping != NULL)
+		munmap(file->mapping, file->mappingSize);
+
+	if (file->layout != NULL)
+		deleteLayout(file->layout);
+
+	free(file->allocation);
+	free(file);
+}
@@ -0,0 +1,59 @@
+#ifndef MATRIX_FILE_H
+#define MATRIX_FILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "elementType.h"
+#include "matrixLayout.h"
+
+#define MATRIX_FILE_MAGIC "MMATRIX\0"
+#define MATRIX_FILE_VERSION 1
+#define MATRIX_FILE_ALIGNMENT 64
+
+// on disk header, the payload starts at payloadOffset which is a multiple of alignment
+typedef struct
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t elementType; // ElementType
+	uint64_t rows;
+	uint64_t cols;
+	uint32_t layout; // LayoutType
+	uint32_t tileSize; // rows for row major
+	uint32_t alignment;
+	uint32_t reserved;
+	uint64_t payloadOffset;
+	uint64_t payloadSize; // bytes, includes the tile padding of tiled layouts
+} MatrixFileHeader;
+
+// a matrix file mapped read only, data points into the mapping (or into allocation when the file had to be parsed)
+typedef struct
+{
+	MatrixFileHeader header;
+	ElementType type;
+	int dimension;
+	MatrixLayout* layout; // null when the payload is row major
+	void* data;
+	void* mapping;
+	size_t mappingSize;
+	void* allocation;
+} MatrixFile;
+
+// data is stored as given, in the layout described by layout (null for row major), returns 0 on success
+int writeMatrixFile(const char* path, const void* data, ElementType type, int dimension, MatrixLayout* layout);
+
+void fillMatrixHeader(MatrixFileHeader* header, ElementType type, int dimension, MatrixLayout* layout);
+
+// writes the header and sizes the file for the payload, returns the open descriptor or -1
+int createMatrixFile(const char* path, ElementType type, int dimension, MatrixLayout* layout, MatrixFileHeader* header);
+
+// validates the header against the file, layout is set for tiled payloads, returns 0 on success
+int readMatrixHeader(int fd, MatrixFileHeader* header, MatrixLayout** layout);
+
+// returns null if the file is missing or not a valid matrix file
+MatrixFile* openMatrixFile(const char* path);
+
+void closeMatrixFile(MatrixFile* file);
+
+#endif
@@ -0,0 +1,798 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "matrixFormats.h"
+#include "threadPool.h"
+
+#define MAX_PARSE_THREADS 16
+#define NPY_CHUNK_ROWS 64
+#define NPY_ALIGNMENT 64
+#define MAX_LINE 256
+
+typedef enum
+{
+	symmetryGeneral = 0,
+	symmetrySymmetric,
+	symmetrySkew
+} Symmetry;
+
+// numpy descriptors for each element type, little endian only
+const char* npyDescr[numElementTypes] =
+{
+	[typeInt32] = "<i4",
+	[typeFloat32] = "<f4",
+	[typeFloat64] = "<f8",
+	[typeInt64] = "<i8",
+	[typeInt16] = "<i2",
+	[typeInt8] = "|i1",
+	[typeUInt8] = "|u1"
+};
+
+static int parseThreads()
+{
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return threads < 1 ? 1 : threads > MAX_PARSE_THREADS ? MAX_PARSE_THREADS : (int)threads;
+}
+
+static long denseOffset(MatrixLayout* layout, int dimension, int row, int col)
+{
+	return layout == NULL ? (long)row * dimension + col : elementOffset(layout, row, col);
+}
+
+// a zeroed matrix of the given layout owned by the file
+static MatrixFile* allocateMatrixFile(ElementType type, int dimension, LayoutType layoutType, int tileSize)
+{
+	MatrixFile* file = (MatrixFile*)malloc(sizeof(MatrixFile));
+
+	if (file == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
+	int elementSize = elementInfo[type].sizeA;
+	MatrixLayout* layout = createLayout(layoutType, dimension, tileSize, elementSize);
+
+	file->type = type;
+	file->dimension = dimension;
+	file->data = allocateLayoutMatrix(layout, elementSize);
+	file->allocation = file->data;
+	file->mapping = NULL;
+	file->mappingSize = 0;
+
+	if (layoutType == layoutRowMajor)
+	{
+		deleteLayout(layout);
+		layout = NULL;
+	}
+
+	file->layout = layout;
+	fillMatrixHeader(&file->header, type, dimension, layout);
+
+	return file;
+}
+
+static void storeInteger(void* data, long offset, ElementType type, long long value)
+{
+	switch (type)
+	{
+	case typeInt32: ((int32_t*)data)[offset] = (int32_t)value; break;
+	case typeFloat32: ((float*)data)[offset] = (float)value; break;
+	case typeFloat64: ((double*)data)[offset] = (double)value; break;
+	case typeInt64: ((int64_t*)data)[offset] = (int64_t)value; break;
+	case typeInt16: ((int16_t*)data)[offset] = (int16_t)value; break;
+	case typeInt8: ((int8_t*)data)[offset] = (int8_t)value; break;
+	case typeUInt8: ((uint8_t*)data)[offset] = (uint8_t)value; break;
+	default: break;
+	}
+}
+
+static void storeReal(void* data, long offset, ElementType type, double value)
+{
+	switch (type)
+	{
+	case typeFloat32: ((float*)data)[offset] = (float)value; break;
+	case typeFloat64: ((double*)data)[offset] = value; break;
+	default: storeInteger(data, offset, type, (long long)value); break;
+	}
+}
+
+static int writeAll(int fd, const void* data, size_t size)
+{
+	const char* bytes = (const char*)data;
+
+	while (size > 0)
+	{
+		ssize_t written = write(fd, bytes, size);
+
+		if (written < 0)
+			return -1;
+
+		bytes += written;
+		size -= written;
+	}
+
+	return 0;
+}
+
+/* .npy */
+
+typedef struct
+{
+	int fd;
+	long dataOffset;
+	int fortranOrder;
+	int elementSize;
+	int dimension;
+	int beginRow, endRow; // rows as stored in the file (columns when fortran ordered)
+	MatrixLayout* layout;
+	char* data;
+	int failed;
+} NpyJob;
+
+// read a band of stored rows a chunk at a time and scatter them into the layout
+static void readNpyRows(void* data)
+{
+	NpyJob* job = (NpyJob*)data;
+	int dimension = job->dimension;
+	int elementSize = job->elementSize;
+	size_t rowBytes = (size_t)elementSize * dimension;
+	char* chunk = (char*)malloc(rowBytes * NPY_CHUNK_ROWS);
+
+	if (chunk == NULL)
+	{
+		job->failed = 1;
+		return;
+	}
+
+	for (int row = job->beginRow; row < job->endRow; row += NPY_CHUNK_ROWS)
+	{
+		int rows = job->endRow - row < NPY_CHUNK_ROWS ? job->endRow - row : NPY_CHUNK_ROWS;
+
+		if (pread(job->fd, chunk, rowBytes * rows, job->dataOffset + rowBytes * row) != (ssize_t)(rowBytes * rows))
+		{
+			job->failed = 1;
+			break;
+		}
+
+		for (int y = 0; y < rows; y++)
+		{
+			if (!job->fortranOrder && job->layout == NULL)
+			{
+				memcpy(&job->data[rowBytes * (row + y)], &chunk[rowBytes * y], rowBytes);
+				continue;
+			}
+
+			for (int x = 0; x < dimension; x++)
+			{
+				long offset = job->fortranOrder ? denseOffset(job->layout, dimension, x, row + y)
+					: denseOffset(job->layout, dimension, row + y, x);
+
+				memcpy(&job->data[offset * elementSize], &chunk[rowBytes * y + (size_t)x * elementSize], elementSize);
+			}
+		}
+	}
+
+	free(chunk);
+}
+
+// pull the value that follows key in the header dictionary
+static const char* npyField(const char* header, const char* key)
+{
+	const char* field = strstr(header, key);
+
+	if (field == NULL || (field = strchr(field + strlen(key), ':')) == NULL)
+		return NULL;
+
+	field++;
+
+	while (*field == ' ')
+		field++;
+
+	return field;
+}
+
+MatrixFile* openNpyFile(const char* path, LayoutType layoutType, int tileSize)
+{
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0)
+	{
+		printf("Cannot open %s\n", path);
+		return NULL;
+	}
+
+	// magic, version, then a 2 (version 1) or 4 byte header length
+	unsigned char preamble[12];
+	struct stat info;
+
+	if (fstat(fd, &info) != 0 || pread(fd, preamble, sizeof(preamble), 0) != sizeof(preamble)
+		|| memcmp(preamble, "\x93NUMPY", 6) != 0)
+	{
+		printf("%s is not a .npy file\n", path);
+		close(fd);
+		return NULL;
+	}
+
+	long headerStart = preamble[6] == 1 ? 10 : 12;
+	long headerLength = preamble[6] == 1 ? preamble[8] | preamble[9] << 8
+		: (long)preamble[8] | preamble[9] << 8 | preamble[10] << 16 | (long)preamble[11] << 24;
+	char* header = (char*)malloc(headerLength + 1);
+
+	if (header == NULL || pread(fd, header, headerLength, headerStart) != headerLength)
+	{
+		printf("%s has a bad header\n", path);
+		free(header);
+		close(fd);
+		return NULL;
+	}
+
+	header[headerLength] = '\0';
+
+	const char* descr = npyField(header, "'descr'");
+	const char* fortran = npyField(header, "'fortran_order'");
+	const char* shape = npyField(header, "'shape'");
+	ElementType type = numElementTypes;
+	long rows = 0, cols = 0;
+
+	for (int t = 0; t < numElementTypes && descr != NULL && *descr == '\''; t++)
+	{
+		// one byte types have no byte order, wider ones have to be little endian
+		int littleEndian = descr[1] == '<' || descr[1] == '=' || descr[1] == '|' || elementInfo[t].sizeA == 1;
+
+		if (littleEndian && strncmp(descr + 2, npyDescr[t] + 1, 2) == 0 && descr[4] == '\'')
+			type = (ElementType)t;
+	}
+
+	if (descr == NULL || fortran == NULL || shape == NULL || type == numElementTypes
+		|| sscanf(shape, "(%ld, %ld)", &rows, &cols) != 2 || rows != cols || rows <= 0 || rows > 0x7fffffff)
+	{
+		printf("%s is not a square matrix of a supported type\n", path);
+		free(header);
+		close(fd);
+		return NULL;
+	}
+
+	int fortranOrder = strncmp(fortran, "True", 4) == 0;
+	int dimension = (int)rows;
+	int elementSize = elementInfo[type].sizeA;
+	long dataOffset = headerStart + headerLength;
+
+	free(header);
+
+	if (dataOffset + (long)elementSize * dimension * dimension > info.st_size)
+	{
+		printf("%s is truncated\n", path);
+		close(fd);
+		return NULL;
+	}
+
+	// already what the scheduler wants so use the page cache directly
+	if (!fortranOrder && layoutType == layoutRowMajor)
+	{
+		MatrixFile* file = (MatrixFile*)malloc(sizeof(MatrixFile));
+
+		if (file == NULL)
+		{
+			printf("Out of memory\n");
+			exit(-1);
+		}
+
+		file->type = type;
+		file->dimension = dimension;
+		file->layout = NULL;
+		file->allocation = NULL;
+		file->mappingSize = dataOffset + (size_t)elementSize * dimension * dimension;
+		file->mapping = mmap(NULL, file->mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+
+		close(fd);
+
+		if (file->mapping == MAP_FAILED)
+		{
+			printf("Cannot map %s\n", path);
+			free(file);
+			return NULL;
+		}
+
+		file->data = (char*)file->mapping + dataOffset;
+		fillMatrixHeader(&file->header, type, dimension, NULL);
+		file->header.payloadOffset = dataOffset;
+
+		return file;
+	}
+
+	MatrixFile* file = allocateMatrixFile(type, dimension, layoutType, tileSize);
+
+	// each thread reads and packs its own band of rows
+	int threads = parseThreads();
+	NpyJob* jobs = (NpyJob*)malloc(sizeof(NpyJob) * threads);
+	ThreadPool* pool = createThreadPool(threads, threads);
+	int failed = 0;
+
+	if (jobs == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
+	for (int i = 0; i < threads; i++)
+	{
+		jobs[i].fd = fd;
+		jobs[i].dataOffset = dataOffset;
+		jobs[i].fortranOrder = fortranOrder;
+		jobs[i].elementSize = elementSize;
+		jobs[i].dimension = dimension;
+		jobs[i].beginRow = (int)((long)dimension * i / threads);
+		jobs[i].endRow = (int)((long)dimension * (i + 1) / threads);
+		jobs[i].layout = file->layout;
+		jobs[i].data = (char*)file->data;
+		jobs[i].failed = 0;
+
+		addJob(pool, readNpyRows, &jobs[i]);
+	}
+
+	destroyThreadPool(pool, shutdown);
+
+	for (int i = 0; i < threads; i++)
+		failed |= jobs[i].failed;
+
+	free(jobs);
+	close(fd);
+
+	if (failed)
+	{
+		printf("Cannot read %s\n", path);
+		closeMatrixFile(file);
+		return NULL;
+	}
+
+	return file;
+}
+
+int writeNpyFile(const char* path, const void* data, ElementType type, int dimension, MatrixLayout* layout)
+{
+	char header[256];
+	int elementSize = elementInfo[type].sizeA;
+
+	if (layout != NULL && layout->type == layoutRowMajor)
+		layout = NULL;
+
+	// pad the dictionary with spaces so the data starts aligned, it has to end in a newline
+	int length = snprintf(header + 10, sizeof(header) - 10, "{'descr': '%s', 'fortran_order': False, 'shape': (%i, %i), }",
+		npyDescr[type], dimension, dimension);
+	int total = (10 + length + 1 + NPY_ALIGNMENT - 1) / NPY_ALIGNMENT * NPY_ALIGNMENT;
+
+	memset(header + 10 + length, ' ', total - 10 - length - 1);
+	header[total - 1] = '\n';
+	memcpy(header, "\x93NUMPY\x01\x00", 8);
+	header[8] = (char)((total - 10) & 0xff);
+	header[9] = (char)((total - 10) >> 8);
+
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	if (fd < 0)
+	{
+		printf("Cannot create %s\n", path);
+		return -1;
+	}
+
+	int status = writeAll(fd, header, total);
+
+	if (layout == NULL)
+		status |= writeAll(fd, data, (size_t)elementSize * dimension * dimension);
+	else
+	{
+		// gather one row at a time out of the tiles
+		char* row = (char*)malloc((size_t)elementSize * dimension);
+
+		if (row == NULL)
+		{
+			printf("Out of memory\n");
+			exit(-1);
+		}
+
+		for (int y = 0; y < dimension && status == 0; y++)
+		{
+			for (int x = 0; x < dimension; x++)
+				memcpy(&row[(size_t)x * elementSize], (const char*)data + elementOffset(layout, y, x) * elementSize, elementSize);
+
+			status |= writeAll(fd, row, (size_t)elementSize * dimension);
+		}
+
+		free(row);
+	}
+
+	if (close(fd) != 0 || status != 0)
+	{
+		printf("Cannot write %s\n", path);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Matrix Market */
+
+typedef struct
+{
+	const char* begin;
+	const char* end;
+	int coordinate;
+	int pattern;
+	int integer;
+	Symmetry symmetry;
+	ElementType type;
+	int dimension;
+	MatrixLayout* layout;
+	char* data;
+	long firstEntry; // index of the first entry in this range (array files)
+	long entries; // entries in this range, counted before parsing array files and as parsed for coordinate files
+	int failed;
+} MatrixMarketJob;
+
+// copy the next line into a terminated buffer, returns 0 at the end of the range and -1 when the line
+// does not fit, its start is still copied so a long comment can be told from a long entry
+static int nextLine(const char** cursor, const char* end, char* line)
+{
+	const char* start = *cursor;
+
+	if (start >= end)
+		return 0;
+
+	const char* newline = memchr(start, '\n', end - start);
+	const char* stop = newline == NULL ? end : newline;
+	size_t length = stop - start < MAX_LINE - 1 ? stop - start : MAX_LINE - 1;
+
+	memcpy(line, start, length);
+	line[length] = '\0';
+
+	*cursor = newline == NULL ? end : newline + 1;
+
+	return length < (size_t)(stop - start) ? -1 : 1;
+}
+
+static int isEntry(const char* line)
+{
+	while (*line == ' ' || *line == '\t' || *line == '\r')
+		line++;
+
+	return *line != '\0' && *line != '%';
+}
+
+static void countEntries(void* data)
+{
+	MatrixMarketJob* job = (MatrixMarketJob*)data;
+	const char* cursor = job->begin;
+	char line[MAX_LINE];
+	int status;
+
+	job->entries = 0;
+
+	while ((status = nextLine(&cursor, job->end, line)) != 0)
+	{
+		if (!isEntry(line))
+			continue;
+
+		// a truncated entry would be parsed as something else
+		if (status < 0)
+			job->failed = 1;
+
+		job->entries++;
+	}
+}
+
+// store a parsed value at (row, col) and its mirror for symmetric files
+static void storeEntry(MatrixMarketJob* job, int row, int col, const char* value)
+{
+	char* next;
+	long offset = denseOffset(job->layout, job->dimension, row, col);
+	long mirror = denseOffset(job->layout, job->dimension, col, row);
+	int mirrored = job->symmetry != symmetryGeneral && row != col;
+
+	if (job->pattern)
+	{
+		storeInteger(job->data, offset, job->type, 1);
+
+		if (mirrored)
+			storeInteger(job->data, mirror, job->type, 1);
+	}
+	else if (job->integer)
+	{
+		long long number = strtoll(value, &next, 10);
+
+		if (next == value)
+			job->failed = 1;
+
+		storeInteger(job->data, offset, job->type, number);
+
+		if (mirrored)
+			storeInteger(job->data, mirror, job->type, job->symmetry == symmetrySkew ? -number : number);
+	}
+	else
+	{
+		double number = strtod(value, &next);
+
+		if (next == value)
+			job->failed = 1;
+
+		storeReal(job->data, offset, job->type, number);
+
+		if (mirrored)
+			storeReal(job->data, mirror, job->type, job->symmetry == symmetrySkew ? -number : number);
+	}
+}
+
+// array files list columns top to bottom, symmetric ones only the lower triangle (skew ones without the diagonal)
+static int columnStart(MatrixMarketJob* job, int col)
+{
+	return job->symmetry == symmetryGeneral ? 0 : job->symmetry == symmetrySkew ? col + 1 : col;
+}
+
+static void parseEntries(void* data)
+{
+	MatrixMarketJob* job = (MatrixMarketJob*)data;
+	const char* cursor = job->begin;
+	char line[MAX_LINE];
+	int dimension = job->dimension;
+
+	// find where the first entry of the range lands
+	int col = 0;
+	long skip = job->firstEntry;
+
+	while (col < dimension && skip >= dimension - columnStart(job, col))
+	{
+		skip -= dimension - columnStart(job, col);
+		col++;
+	}
+
+	int row = columnStart(job, col) + (int)skip;
+	int status;
+
+	while (!job->failed && (status = nextLine(&cursor, job->end, line)) != 0)
+	{
+		if (!isEntry(line))
+			continue;
+
+		if (status < 0)
+		{
+			job->failed = 1;
+			break;
+		}
+
+		if (job->coordinate)
+		{
+			int r, c, consumed = 0;
+
+			// %d keeps an index with a leading zero decimal
+			if (sscanf(line, " %d %d%n", &r, &c, &consumed) != 2 || r < 1 || c < 1 || r > dimension || c > dimension)
+			{
+				job->failed = 1;
+				break;
+			}
+
+			storeEntry(job, r - 1, c - 1, line + consumed);
+			job->entries++;
+		}
+		else
+		{
+			if (col >= dimension)
+			{
+				job->failed = 1;
+				break;
+			}
+
+			storeEntry(job, row, col, line);
+
+			for (row++; col < dimension && row >= dimension; row = columnStart(job, col))
+				col++;
+		}
+	}
+}
+
+MatrixFile* openMatrixMarketFile(const char* path, ElementType type, LayoutType layoutType, int tileSize)
+{
+	int fd = open(path, O_RDONLY);
+	struct stat info;
+
+	if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0)
+	{
+		printf("Cannot open %s\n", path);
+
+		if (fd >= 0)
+			close(fd);
+
+		return NULL;
+	}
+
+	// the threads stream through the mapping, each over its own part of the file
+	size_t size = info.st_size;
+	const char* text = (const char*)mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+
+	close(fd);
+
+	if (text == MAP_FAILED)
+	{
+		printf("Cannot map %s\n", path);
+		return NULL;
+	}
+
+	madvise((void*)text, size, MADV_SEQUENTIAL);
+
+	const char* cursor = text;
+	const char* end = text + size;
+	char line[MAX_LINE], format[32], field[32], symmetry[32];
+	long rows = 0, cols = 0, entries = 0;
+	int status = nextLine(&cursor, end, line);
+	int valid = status > 0 && sscanf(line, "%%%%MatrixMarket matrix %31s %31s %31s", format, field, symmetry) == 3;
+
+	// skip the comments to the size line
+	while (valid && (status = nextLine(&cursor, end, line)) != 0 && !isEntry(line));
+
+	valid = valid && status > 0;
+
+	MatrixMarketJob settings;
+	settings.coordinate = strcasecmp(format, "coordinate") == 0;
+	settings.pattern = strcasecmp(field, "pattern") == 0;
+	settings.integer = strcasecmp(field, "integer") == 0;
+	settings.symmetry = strcasecmp(symmetry, "symmetric") == 0 ? symmetrySymmetric
+		: strcasecmp(symmetry, "skew-symmetric") == 0 ? symmetrySkew : symmetryGeneral;
+
+	if (!valid || (!settings.coordinate && strcasecmp(format, "array") != 0)
+		|| (!settings.pattern && !settings.integer && strcasecmp(field, "real") != 0)
+		|| (settings.symmetry == symmetryGeneral && strcasecmp(symmetry, "general") != 0)
+		|| (settings.pattern && !settings.coordinate)
+		|| sscanf(line, "%ld %ld %ld", &rows, &cols, &entries) < (settings.coordinate ? 3 : 2)
+		|| rows != cols || rows <= 0 || rows > 0x7fffffff)
+	{
+		printf("%s is not a square real, integer or pattern Matrix Market file\n", path);
+		munmap((void*)text, size);
+		return NULL;
+	}
+
+	MatrixFile* file = allocateMatrixFile(type, (int)rows, layoutType, tileSize);
+
+	// split the body on line boundaries
+	int threads = parseThreads();
+	MatrixMarketJob* jobs = (MatrixMarketJob*)malloc(sizeof(MatrixMarketJob) * threads);
+	int failed = 0;
+
+	if (jobs == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
+	const char* begin = cursor;
+
+	for (int i = 0; i < threads; i++)
+	{
+		const char* split = i == threads - 1 ? end : cursor + (end - cursor) * (i + 1) / threads;
+
+		if (split < begin)
+			split = begin;
+
+		const char* newline = split < end ? memchr(split, '\n', end - split) : NULL;
+
+		jobs[i] = settings;
+		jobs[i].type = type;
+		jobs[i].dimension = (int)rows;
+		jobs[i].layout = file->layout;
+		jobs[i].data = (char*)file->data;
+		jobs[i].begin = begin;
+		jobs[i].end = i == threads - 1 || newline == NULL ? end : newline + 1;
+		jobs[i].failed = 0;
+		jobs[i].firstEntry = 0;
+		jobs[i].entries = 0;
+
+		begin = jobs[i].end;
+	}
+
+	// array files need to know where each range starts in the entry order
+	ThreadPool* pool;
+
+	if (!settings.coordinate)
+	{
+		pool = createThreadPool(threads, threads);
+
+		for (int i = 0; i < threads; i++)
+			addJob(pool, countEntries, &jobs[i]);
+
+		destroyThreadPool(pool, shutdown);
+
+		for (int i = 1; i < threads; i++)
+			jobs[i].firstEntry = jobs[i - 1].firstEntry + jobs[i - 1].entries;
+	}
+
+	pool = createThreadPool(threads, threads);
+
+	for (int i = 0; i < threads; i++)
+		addJob(pool, parseEntries, &jobs[i]);
+
+	destroyThreadPool(pool, shutdown);
+
+	long parsed = 0;
+
+	for (int i = 0; i < threads; i++)
+	{
+		failed |= jobs[i].failed;
+		parsed += jobs[i].entries;
+	}
+
+	free(jobs);
+	munmap((void*)text, size);
+
+	if (failed)
+	{
+		printf("%s has a bad entry\n", path);
+		closeMatrixFile(file);
+		return NULL;
+	}
+
+	// array files hold every entry of their triangle, coordinate files as many as their size line says
+	if (!settings.coordinate)
+		entries = settings.symmetry == symmetryGeneral ? rows * rows
+			: settings.symmetry == symmetrySymmetric ? rows * (rows + 1) / 2 : rows * (rows - 1) / 2;
+
+	// a short list would leave the matrix partly filled
+	if (parsed != entries)
+	{
+		printf("%s lists %ld entries instead of %ld\n", path, parsed, entries);
+		closeMatrixFile(file);
+		return NULL;
+	}
+
+	return file;
+}
+
+int writeMatrixMarketFile(const char* path, const void* data, ElementType type, int dimension, MatrixLayout* layout)
+{
+	FILE* file = fopen(path, "w");
+
+	if (file == NULL)
+	{
+		printf("Cannot create %s\n", path);
+		return -1;
+	}
+
+	if (layout != NULL && layout->type == layoutRowMajor)
+		layout = NULL;
+
+	int real = type == typeFloat32 || type == typeFloat64;
+
+	fprintf(file, "%%%%MatrixMarket matrix array %s general\n%i %i\n", real ? "real" : "integer", dimension, dimension);
+
+	// dense values are listed a column at a time
+	for (int x = 0; x < dimension; x++)
+		for (int y = 0; y < dimension; y++)
+		{
+			long offset = denseOffset(layout, dimension, y, x);
+
+			switch (type)
+			{
+			case typeInt32: fprintf(file, "%i\n", ((const int32_t*)data)[offset]); break;
+			case typeFloat32: fprintf(file, "%.9g\n", ((const float*)data)[offset]); break;
+			case typeFloat64: fprintf(file, "%.17g\n", ((const double*)data)[offset]); break;
+			case typeInt64: fprintf(file, "%lli\n", (long long)((const int64_t*)data)[offset]); break;
+			case typeInt16: fprintf(file, "%i\n", ((const int16_t*)data)[offset]); break;
+			case typeInt8: fprintf(file, "%i\n", ((const int8_t*)data)[offset]); break;
+			case typeUInt8: fprintf(file, "%i\n", ((const uint8_t*)data)[offset]); break;
+			default: break;
+			}
+		}
+
+	if (fclose(file) != 0)
+	{
+		printf("Cannot write %s\n", path);
+		return -1;
+	}
+
+	return 0;
+}
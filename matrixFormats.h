@@ -0,0 +1,22 @@
+#ifndef MATRIX_FORMATS_H
+#define MATRIX_FORMATS_H
+
+#include "elementType.h"
+#include "matrixLayout.h"
+#include "matrixFile.h"
+
+// the readers return square matrices packed into the requested layout (CACHE_TILE_SIZE picks the tile size)
+// close them with closeMatrixFile, null is returned if the file cannot be read
+
+// row major .npy files with a matching layout are mapped rather than copied
+MatrixFile* openNpyFile(const char* path, LayoutType layoutType, int tileSize);
+
+// coordinate and array Matrix Market files, values are converted to type
+MatrixFile* openMatrixMarketFile(const char* path, ElementType type, LayoutType layoutType, int tileSize);
+
+// data is stored as given, in the layout described by layout (null for row major), returns 0 on success
+int writeNpyFile(const char* path, const void* data, ElementType type, int dimension, MatrixLayout* layout);
+
+int writeMatrixMarketFile(const char* path, const void* data, ElementType type, int dimension, MatrixLayout* layout);
+
+#endif
@@ -0,0 +1,214 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "matrixLayout.h"
+
+#define MIN_TILE_SIZE 16
+#define DEFAULT_L2_SIZE (256 * 1024)
+
+static int nextPowerOfTwo(int value)
+{
+	int power = 1;
+
+	while (power < value)
+		power <<= 1;
+
+	return power;
+}
+
+// pull the odd or even bits out of a morton code
+static int compactBits(unsigned long code)
+{
+	int value = 0;
+
+	for (int bit = 0; code != 0; bit++, code >>= 2)
+		value |= (code & 1) << bit;
+
+	return value;
+}
+
+int chooseTileSize(int dimension, int elementSize)
+{
+	long cacheSize = sysconf(_SC_LEVEL2_CACHE_SIZE);
+
+	if (cacheSize <= 0)
+		cacheSize = DEFAULT_L2_SIZE;
+
+	// three tiles (A, B and the result) should sit in L2 together
+	int tileSize = MIN_TILE_SIZE;
+
+	while ((long)(tileSize + MIN_TILE_SIZE) * (tileSize + MIN_TILE_SIZE) * elementSize * 3 <= cacheSize)
+		tileSize += MIN_TILE_SIZE;
+
+	// prefer a tile that splits the matrix evenly
+	while (tileSize > MIN_TILE_SIZE && dimension % tileSize != 0)
+		tileSize -= MIN_TILE_SIZE;
+
+	return tileSize;
+}
+
+MatrixLayout* createLayout(LayoutType type, int dimension, int tileSize, int elementSize)
+{
+	MatrixLayout* layout = (MatrixLayout*)malloc(sizeof(MatrixLayout));
+
+	if (layout == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
+	if (tileSize == CACHE_TILE_SIZE)
+		tileSize = chooseTileSize(dimension, elementSize);
+
+	layout->type = type;
+	layout->dimension = dimension;
+	layout->tileSize = type == layoutRowMajor ? dimension : tileSize;
+	layout->tilesPerSide = (dimension + layout->tileSize - 1) / layout->tileSize;
+	layout->tileSlot = NULL;
+
+	// row major has no tiles to order
+	if (type == layoutRowMajor)
+		return layout;
+
+	int tilesPerSide = layout->tilesPerSide;
+	layout->tileSlot = (int*)malloc(sizeof(int) * tilesPerSide * tilesPerSide);
+
+	if (layout->tileSlot == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
+	if (type == layoutTiled)
+	{
+		for (int i = 0; i < tilesPerSide * tilesPerSide; i++)
+			layout->tileSlot[i] = i;
+	}
+	else
+	{
+		// walk the z-curve over the enclosing power of two grid and skip the tiles that fall outside
+		unsigned long side = nextPowerOfTwo(tilesPerSide);
+		int slot = 0;
+
+		for (unsigned long code = 0; code < side * side; code++)
+		{
+			int tileRow = compactBits(code >> 1);
+			int tileCol = compactBits(code);
+
+			if (tileRow < tilesPerSide && tileCol < tilesPerSide)
+				layout->tileSlot[tileRow * tilesPerSide + tileCol] = slot++;
+		}
+	}
+
+	return layout;
+}
+
+void deleteLayout(MatrixLayout* layout)
+{
+	free(layout->tileSlot);
+	free(layout);
+}
+
+long layoutSize(MatrixLayout* layout)
+{
+	long paddedSide = (long)layout->tilesPerSide * layout->tileSize;
+
+	return paddedSide * paddedSide;
+}
+
+void* allocateLayoutMatrix(MatrixLayout* layout, int elementSize)
+{
+	// keep every tile on a cache line boundary (tiles are multiples of 16 elements)
+	size_t bytes = (size_t)elementSize * layoutSize(layout);
+	bytes = (bytes + 63) / 64 * 64;
+
+	void* matrix = aligned_alloc(64, bytes);
+
+	if (matrix == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
+	// zero the padding on the bottom and right tiles
+	memset(matrix, 0, bytes);
+
+	return matrix;
+}
+
+long tileOffset(MatrixLayout* layout, int tileRow, int tileCol)
+{
+	if (layout->type == layoutRowMajor)
+		return (long)tileRow * layout->tileSize * layout->dimension + tileCol * layout->tileSize;
+
+	long tileArea = (long)layout->tileSize * layout->tileSize;
+
+	return layout->tileSlot[tileRow * layout->tilesPerSide + tileCol] * tileArea;
+}
+
+long elementOffset(MatrixLayout* layout, int row, int col)
+{
+	if (layout->type == layoutRowMajor)
+		return (long)row * layout->dimension + col;
+
+	int tileSize = layout->tileSize;
+
+	return tileOffset(layout, row / tileSize, col / tileSize) + (row % tileSize) * tileSize + col % tileSize;
+}
+
+void convertToLayout(MatrixLayout* layout, void* rowMajor, void* out, int elementSize)
+{
+	char* src = (char*)rowMajor;
+	char* dst = (char*)out;
+	int dimension = layout->dimension;
+	int tileSize = layout->tileSize;
+
+	if (layout->type == layoutRowMajor)
+	{
+		memcpy(out, rowMajor, (size_t)elementSize * dimension * dimension);
+		return;
+	}
+
+	// copy each tile row by row so both sides stay sequential
+	for (int tileRow = 0; tileRow < layout->tilesPerSide; tileRow++)
+		for (int tileCol = 0; tileCol < layout->tilesPerSide; tileCol++)
+		{
+			char* tile = &dst[tileOffset(layout, tileRow, tileCol) * elementSize];
+			int rows = dimension - tileRow * tileSize < tileSize ? dimension - tileRow * tileSize : tileSize;
+			int cols = dimension - tileCol * tileSize < tileSize ? dimension - tileCol * tileSize : tileSize;
+
+			for (int y = 0; y < rows; y++)
+				memcpy(&tile[(long)y * tileSize * elementSize],
+					&src[((long)(tileRow * tileSize + y) * dimension + tileCol * tileSize) * elementSize],
+					(size_t)elementSize * cols);
+		}
+}
+
+void convertFromLayout(MatrixLayout* layout, void* in, void* rowMajor, int elementSize)
+{
+	char* src = (char*)in;
+	char* dst = (char*)rowMajor;
+	int dimension = layout->dimension;
+	int tileSize = layout->tileSize;
+
+	if (layout->type == layoutRowMajor)
+	{
+		memcpy(rowMajor, in, (size_t)elementSize * dimension * dimension);
+		return;
+	}
+
+	for (int tileRow = 0; tileRow < layout->tilesPerSide; tileRow++)
+		for (int tileCol = 0; tileCol < layout->tilesPerSide; tileCol++)
+		{
+			char* tile = &src[tileOffset(layout, tileRow, tileCol) * elementSize];
+			int rows = dimension - tileRow * tileSize < tileSize ? dimension - tileRow * tileSize : tileSize;
+			int cols = dimension - tileCol * tileSize < tileSize ? dimension - tileCol * tileSize : tileSize;
+
+			for (int y = 0; y < rows; y++)
+				memcpy(&dst[((long)(tileRow * tileSize + y) * dimension + tileCol * tileSize) * elementSize],
+					&tile[(long)y * tileSize * elementSize],
+					(size_t)elementSize * cols);
+		}
+}
@@ -0,0 +1,42 @@
+#ifndef MATRIX_LAYOUT_H
+#define MATRIX_LAYOUT_H
+
+// pick a tile size from the cache size when passed as the tile size
+#define CACHE_TILE_SIZE 0
+
+typedef enum
+{
+	layoutRowMajor = 0,
+	layoutTiled, // tiles stored one after another in row-major tile order
+	layoutMorton // tiles stored in Z-order
+} LayoutType;
+
+// offsets are counted in elements so one layout serves every element type
+typedef struct
+{
+	LayoutType type;
+	int dimension;
+	int tileSize;
+	int tilesPerSide;
+	int* tileSlot; // storage slot of each tile indexed by tileRow * tilesPerSide + tileCol
+} MatrixLayout;
+
+MatrixLayout* createLayout(LayoutType type, int dimension, int tileSize, int elementSize);
+
+void deleteLayout(MatrixLayout* layout);
+
+int chooseTileSize(int dimension, int elementSize);
+
+long layoutSize(MatrixLayout* layout);
+
+void* allocateLayoutMatrix(MatrixLayout* layout, int elementSize);
+
+long tileOffset(MatrixLayout* layout, int tileRow, int tileCol);
+
+long elementOffset(MatrixLayout* layout, int row, int col);
+
+void convertToLayout(MatrixLayout* layout, void* rowMajor, void* out, int elementSize);
+
+void convertFromLayout(MatrixLayout* layout, void* in, void* rowMajor, int elementSize);
+
+#endif
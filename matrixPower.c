@@ -0,0 +1,158 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "matrixPower.h"
+#include "matrixLayout.h"
+#include "scheduler.h"
+
+static void* identityMatrix(int dimension, ElementType type)
+{
+	int elementSize = elementInfo[type].sizeA;
+	char* I = (char*)calloc((size_t)dimension * dimension, elementSize);
+
+	if (I == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
+	for (int i = 0; i < dimension; i++)
+	{
+		void* one = &I[((long)i * dimension + i) * elementSize];
+
+		switch (type)
+		{
+			case typeInt32: *(int32_t*)one = 1; break;
+			case typeFloat32: *(float*)one = 1.0f; break;
+			case typeFloat64: *(double*)one = 1.0; break;
+			case typeInt64: *(int64_t*)one = 1; break;
+			default: break;
+		}
+	}
+
+	return I;
+}
+
+void* matrixPower(const void* A, int dimension, ElementType type, int exponent)
+{
+	if (elementInfo[type].outType != type || exponent < 0)
+	{
+		printf("Cannot raise a %s matrix to the power %i\n", elementInfo[type].name, exponent);
+		exit(-1);
+	}
+
+	if (exponent == 0)
+		return identityMatrix(dimension, type);
+
+	int elementSize = elementInfo[type].sizeA;
+	size_t bytes = (size_t)dimension * dimension * elementSize;
+	char* result = (char*)malloc(bytes);
+
+	if (result == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
+	if (exponent == 1)
+	{
+		memcpy(result, A, bytes);
+		return result;
+	}
+
+	// every step reads and writes the tiles in place, so A is packed once and nothing is packed again
+	// until the end, matrices too small to tile run row major
+	MatrixLayout* layout = NULL;
+	MatrixLayout* padded = NULL;
+	void* base = (void*)A;
+	int schedulerDimension = dimension;
+
+	if (dimension > SKINNY_COLUMNS)
+	{
+		// the scheduler needs whole tiles, so a dimension off the 16 element grid is padded out with zero
+		// rows and columns, which stay zero in every power, the padded layout stores its tiles at the
+		// same offsets as the real one, so the real one packs and unpacks and the padded one is multiplied
+		schedulerDimension = (dimension + 15) / 16 * 16;
+		int tileSize = chooseTileSize(schedulerDimension, elementSize);
+
+		layout = createLayout(layoutTiled, dimension, tileSize, elementSize);
+		padded = createLayout(layoutTiled, schedulerDimension, tileSize, elementSize);
+		base = allocateLayoutMatrix(layout, elementSize);
+		convertToLayout(layout, (void*)A, base, elementSize);
+	}
+
+	Scheduler* scheduler = createTypedScheduler(base, base, schedulerDimension, type);
+
+	if (layout != NULL)
+	{
+		setSchedulerLayout(scheduler, padded, padded);
+		setSchedulerOutputLayout(scheduler, padded);
+	}
+
+	// the products ping-pong between two buffers, the scheduler's own row major output serves when untiled
+	void* buffers[2];
+
+	if (layout != NULL)
+	{
+		free(scheduler->dataOut);
+		buffers[0] = allocateLayoutMatrix(layout, elementSize);
+		buffers[1] = allocateLayoutMatrix(layout, elementSize);
+	}
+	else
+	{
+		buffers[0] = scheduler->dataOut;
+		buffers[1] = malloc(bytes);
+
+		if (buffers[1] == NULL)
+		{
+			printf("Out of memory\n");
+			exit(-1);
+		}
+	}
+
+	void* current = base;
+	int next = 0;
+	int topBit = 31 - __builtin_clz((unsigned)exponent);
+
+	// left to right binary exponentiation, a square per bit and a product with A for every set bit
+	for (int bit = topBit - 1; bit >= 0; bit--)
+	{
+		scheduler->A = current;
+		scheduler->B = current;
+		scheduler->dataOut = buffers[next];
+		runScheduler(scheduler);
+		current = buffers[next];
+		next ^= 1;
+
+		if (exponent & (1 << bit))
+		{
+			scheduler->A = current;
+			scheduler->B = base;
+			scheduler->dataOut = buffers[next];
+			runScheduler(scheduler);
+			current = buffers[next];
+			next ^= 1;
+		}
+	}
+
+	if (layout != NULL)
+		convertFromLayout(layout, current, result, elementSize);
+	else
+		memcpy(result, current, bytes);
+
+	scheduler->dataOut = NULL;
+	deleteScheduler(scheduler);
+	free(buffers[0]);
+	free(buffers[1]);
+
+	if (layout != NULL)
+	{
+		free(base);
+		deleteLayout(layout);
+		deleteLayout(padded);
+	}
+
+	return result;
+}
@@ -0,0 +1,11 @@
+#ifndef MATRIX_POWER_H
+#define MATRIX_POWER_H
+
+#include "elementType.h"
+
+// A^exponent by repeated squaring for a row major A whose type is also its accumulator type
+// (int32 wraps, float32, float64, int64), returns a row major matrix the caller frees,
+// any dimension works, tiled runs pad the edge tiles to the 16 element grid with zeros
+void* matrixPower(const void* A, int dimension, ElementType type, int exponent);
+
+#endif
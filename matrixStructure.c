@@ -0,0 +1,62 @@
+#include <string.h>
+#include <limits.h>
+
+#include "matrixStructure.h"
+
+// every structure is a band of diagonals, col - row has to lie in [-lower, upper]
+static void structureBand(const MatrixStructure* structure, long* lower, long* upper)
+{
+	*lower = structure->type == structureUpper ? 0 : structure->type == structureBanded ? structure->lower : INT_MAX;
+	*upper = structure->type == structureLower ? 0 : structure->type == structureBanded ? structure->upper : INT_MAX;
+}
+
+int structureKeeps(const MatrixStructure* structure, int row, int col)
+{
+	long lower, upper;
+	structureBand(structure, &lower, &upper);
+
+	return col - row >= -lower && col - row <= upper;
+}
+
+TileCoverage structureCoverage(const MatrixStructure* structure, int row, int col, int tileSize)
+{
+	long lower, upper;
+	structureBand(structure, &lower, &upper);
+
+	// the diagonals the tile touches
+	long first = (long)col - row - (tileSize - 1);
+	long last = (long)col - row + (tileSize - 1);
+
+	if (last < -lower || first > upper)
+		return tileEmpty;
+
+	if (first >= -lower && last <= upper)
+		return tileFull;
+
+	return tilePartial;
+}
+
+void maskToStructure(const MatrixStructure* structure, void* tile, int elementSize, int tileSize, int row, int col)
+{
+	char* data = (char*)tile;
+
+	for (int y = 0; y < tileSize; y++)
+		for (int x = 0; x < tileSize; x++)
+			if (!structureKeeps(structure, row + y, col + x))
+				memset(&data[(y * tileSize + x) * elementSize], 0, elementSize);
+}
+
+MatrixStructure transposeStructure(const MatrixStructure* structure)
+{
+	MatrixStructure transposed = *structure;
+
+	if (structure->type == structureUpper)
+		transposed.type = structureLower;
+	else if (structure->type == structureLower)
+		transposed.type = structureUpper;
+
+	transposed.lower = structure->upper;
+	transposed.upper = structure->lower;
+
+	return transposed;
+}
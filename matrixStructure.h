@@ -0,0 +1,36 @@
+#ifndef MATRIX_STRUCTURE_H
+#define MATRIX_STRUCTURE_H
+
+typedef enum
+{
+	structureDense = 0,
+	structureUpper, // upper triangular including the diagonal
+	structureLower, // lower triangular including the diagonal
+	structureBanded
+} StructureType;
+
+// entries outside the structure are taken to be zero whatever the matrix holds there
+typedef struct
+{
+	StructureType type;
+	int lower, upper; // diagonals kept below and above the main one for banded matrices
+} MatrixStructure;
+
+typedef enum
+{
+	tileEmpty = 0, // nothing in the tile is kept
+	tilePartial, // the tile crosses the edge of the structure and has to be masked
+	tileFull
+} TileCoverage;
+
+int structureKeeps(const MatrixStructure* structure, int row, int col);
+
+// how much of the tileSize x tileSize tile starting at (row, col) is kept
+TileCoverage structureCoverage(const MatrixStructure* structure, int row, int col, int tileSize);
+
+// zero the entries of a packed row major tile that fall outside the structure
+void maskToStructure(const MatrixStructure* structure, void* tile, int elementSize, int tileSize, int row, int col);
+
+MatrixStructure transposeStructure(const MatrixStructure* structure);
+
+#endif
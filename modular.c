@@ -0,0 +1,29 @@
+#include <limits.h>
+
+#include "modular.h"
+
+int initModulus(Modulus* modulus, uint32_t value)
+{
+	if (value < 3 || value >= (1u << 31) || value % 2 == 0)
+		return 0;
+
+	// newton's iteration doubles the correct low bits of the inverse each step
+	uint32_t inverse = value;
+
+	for (int i = 0; i < 5; i++)
+		inverse *= 2 - value * inverse;
+
+	uint64_t shift = ((uint64_t)1 << 32) % value;
+	uint64_t shift64 = shift * shift % value;
+
+	// a segment has to stay below modulus * 2^32 to be reduced
+	uint64_t square = (uint64_t)(value - 1) * (value - 1);
+	uint64_t lazy = (((uint64_t)value << 32) - 1) / square;
+
+	modulus->modulus = value;
+	modulus->inverse = -inverse;
+	modulus->correction = (uint32_t)(shift64 * shift % value);
+	modulus->lazy = lazy > INT_MAX ? INT_MAX : (int)lazy;
+
+	return 1;
+}
@@ -0,0 +1,35 @@
+#ifndef MODULAR_H
+#define MODULAR_H
+
+#include <stdint.h>
+
+// constants for reducing int32 products modulo an odd modulus below 2^31 with Montgomery's method
+typedef struct
+{
+	uint32_t modulus;
+	uint32_t inverse; // -modulus^-1 mod 2^32
+	uint32_t correction; // 2^96 mod modulus, undoes the two 2^-32 factors the reductions leave
+	int lazy; // products that can be summed in 64 bits before a reduction is needed
+} Modulus;
+
+// returns 0 when the modulus is even or out of range
+int initModulus(Modulus* modulus, uint32_t value);
+
+// x * 2^-32 mod modulus in [0, 2 * modulus), x has to be below modulus * 2^32
+static inline uint64_t montgomeryReduce(uint64_t x, uint32_t modulus, uint32_t inverse)
+{
+	uint32_t m = (uint32_t)x * inverse;
+
+	return (x + (uint64_t)m * modulus) >> 32;
+}
+
+// a sum of reduced segments back to a plain residue in [0, modulus)
+static inline uint32_t finishModular(uint64_t sum, const Modulus* modulus)
+{
+	uint64_t value = montgomeryReduce(sum, modulus->modulus, modulus->inverse);
+	value = montgomeryReduce(value * modulus->correction, modulus->modulus, modulus->inverse);
+
+	return (uint32_t)(value >= modulus->modulus ? value - modulus->modulus : value);
+}
+
+#endif
@@ -0,0 +1,473 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "outOfCore.h"
+#include "scheduler.h"
+#include "matrixFile.h"
+#include "blockSum.h"
+#include "threadPool.h"
+
+#define IO_THREADS 4
+#define PREFETCH_DEPTH 2
+#define MIN_CACHED_TILES (2 * (PREFETCH_DEPTH + 1))
+#define TILE_ALIGNMENT 64 // tiles are multiplied by the scheduler in 64 x 64 blocks
+#define PASSES_IN_FLIGHT (2 * MAX_CPU_THREADS) // queued and running scheduler passes, each can hold a group's accumulator
+
+// an operand file read tile by tile
+typedef struct
+{
+	int fd;
+	MatrixFileHeader header;
+	MatrixLayout* layout; // null when the payload is row major
+	int elementSize;
+	int dimension;
+} TileSource;
+
+typedef struct TileCache TileCache;
+
+typedef struct
+{
+	TileCache* cache;
+	TileSource* source; // null while the slot is empty
+	int tileRow, tileCol;
+	void* data;
+	int ready; // the read has finished
+	int pins; // users that need the tile to stay resident
+	long lastUse;
+} CachedTile;
+
+// fixed number of tile slots shared by A and B, evicted least recently used
+struct TileCache
+{
+	CachedTile* tiles;
+	int numTiles;
+	int tileSize;
+	MatrixLayout* layout; // every cached tile is stored in the scheduler's own blocks so it is multiplied in place
+	long clock;
+	int failed;
+	pthread_mutex_t lock;
+	pthread_cond_t loaded;
+	ThreadPool* ioPool;
+};
+
+static int openTileSource(TileSource* source, const char* path)
+{
+	source->fd = open(path, O_RDONLY);
+
+	if (source->fd < 0)
+	{
+		printf("Cannot open %s\n", path);
+		return -1;
+	}
+
+	if (readMatrixHeader(source->fd, &source->header, &source->layout) != 0)
+	{
+		printf("%s is not a valid matrix file\n", path);
+		close(source->fd);
+		return -1;
+	}
+
+	source->elementSize = elementInfo[source->header.elementType].sizeA;
+	source->dimension = (int)source->header.rows;
+
+	return 0;
+}
+
+static void closeTileSource(TileSource* source)
+{
+	if (source->layout != NULL)
+		deleteLayout(source->layout);
+
+	close(source->fd);
+}
+
+static int readAll(int fd, void* data, size_t size, off_t offset)
+{
+	char* bytes = (char*)data;
+
+	while (size > 0)
+	{
+		ssize_t count = pread(fd, bytes, size, offset);
+
+		if (count <= 0)
+			return -1;
+
+		bytes += count;
+		size -= count;
+		offset += count;
+	}
+
+	return 0;
+}
+
+static int writeAll(int fd, const void* data, size_t size, off_t offset)
+{
+	const char* bytes = (const char*)data;
+
+	while (size > 0)
+	{
+		ssize_t count = pwrite(fd, bytes, size, offset);
+
+		if (count < 0)
+			return -1;
+
+		bytes += count;
+		size -= count;
+		offset += count;
+	}
+
+	return 0;
+}
+
+// read a tileSize x tileSize tile into the cache's layout, the part past the matrix edge is zero
+static int readTile(TileSource* source, MatrixLayout* layout, int tileRow, int tileCol, void* out)
+{
+	char* tile = (char*)out;
+	int elementSize = source->elementSize;
+	int dimension = source->dimension;
+	int tileSize = layout->dimension;
+	int rows = dimension - tileRow * tileSize < tileSize ? dimension - tileRow * tileSize : tileSize;
+	int cols = dimension - tileCol * tileSize < tileSize ? dimension - tileCol * tileSize : tileSize;
+
+	memset(tile, 0, (size_t)elementSize * tileSize * tileSize);
+
+	for (int y = 0; y < rows; y++)
+	{
+		int row = tileRow * tileSize + y;
+
+		// runs stay within one stored tile and one block of the cached tile so both ends are contiguous
+		for (int x = 0; x < cols;)
+		{
+			int col = tileCol * tileSize + x;
+			int run = cols - x < layout->tileSize - x % layout->tileSize ? cols - x : layout->tileSize - x % layout->tileSize;
+			long offset;
+
+			if (source->layout == NULL)
+				offset = (long)row * dimension + col;
+			else
+			{
+				int storedTile = source->layout->tileSize;
+
+				if (run > storedTile - col % storedTile)
+					run = storedTile - col % storedTile;
+
+				offset = elementOffset(source->layout, row, col);
+			}
+
+			if (readAll(source->fd, &tile[elementOffset(layout, y, x) * elementSize], (size_t)run * elementSize,
+				source->header.payloadOffset + offset * elementSize) != 0)
+				return -1;
+
+			x += run;
+		}
+	}
+
+	return 0;
+}
+
+static void loadTile(void* data)
+{
+	CachedTile* tile = (CachedTile*)data;
+	TileCache* cache = tile->cache;
+
+	int status = readTile(tile->source, cache->layout, tile->tileRow, tile->tileCol, tile->data);
+
+	pthread_mutex_lock(&(cache->lock));
+
+	tile->ready = 1;
+
+	if (status != 0)
+		cache->failed = 1;
+
+	pthread_cond_broadcast(&(cache->loaded));
+	pthread_mutex_unlock(&(cache->lock));
+}
+
+// find or start loading a tile, pinned requests wait until it is resident while prefetches return null when no slot is free
+static CachedTile* acquireTile(TileCache* cache, TileSource* source, int tileRow, int tileCol, int pin)
+{
+	pthread_mutex_lock(&(cache->lock));
+
+	while (1)
+	{
+		CachedTile* victim = NULL;
+
+		for (int i = 0; i < cache->numTiles; i++)
+		{
+			CachedTile* tile = &cache->tiles[i];
+
+			if (tile->source == source && tile->tileRow == tileRow && tile->tileCol == tileCol)
+			{
+				tile->lastUse = ++cache->clock;
+
+				if (pin)
+				{
+					tile->pins++;
+
+					while (!tile->ready)
+						pthread_cond_wait(&(cache->loaded), &(cache->lock));
+				}
+
+				pthread_mutex_unlock(&(cache->lock));
+				return tile;
+			}
+
+			// empty slots first then the oldest tile nobody is using
+			if (tile->source == NULL)
+			{
+				if (victim == NULL || victim->source != NULL)
+					victim = tile;
+			}
+			else if (tile->ready && tile->pins == 0 && (victim == NULL || (victim->source != NULL && tile->lastUse < victim->lastUse)))
+				victim = tile;
+		}
+
+		if (victim != NULL)
+		{
+			victim->source = source;
+			victim->tileRow = tileRow;
+			victim->tileCol = tileCol;
+			victim->ready = 0;
+			victim->pins = pin;
+			victim->lastUse = ++cache->clock;
+
+			pthread_mutex_unlock(&(cache->lock));
+
+			// read in the background, or right here if the io queue is backed up
+			if (addJob(cache->ioPool, loadTile, victim) == queueFull)
+				loadTile(victim);
+
+			if (pin)
+			{
+				pthread_mutex_lock(&(cache->lock));
+
+				while (!victim->ready)
+					pthread_cond_wait(&(cache->loaded), &(cache->lock));
+
+				pthread_mutex_unlock(&(cache->lock));
+			}
+
+			return victim;
+		}
+
+		if (!pin)
+		{
+			pthread_mutex_unlock(&(cache->lock));
+			return NULL;
+		}
+
+		// every slot is loading or in use so wait for one to free up
+		pthread_cond_wait(&(cache->loaded), &(cache->lock));
+	}
+}
+
+static void releaseTile(TileCache* cache, CachedTile* tile)
+{
+	pthread_mutex_lock(&(cache->lock));
+
+	tile->pins--;
+
+	pthread_cond_broadcast(&(cache->loaded));
+	pthread_mutex_unlock(&(cache->lock));
+}
+
+// walk C tile rows in order, C tiles in a snake and k back and forth so the tiles used last are used again first
+static void stepTiles(long step, int tilesPerSide, int* i, int* j, int* k)
+{
+	long perRow = (long)tilesPerSide * tilesPerSide;
+	int jj = (int)(step % perRow / tilesPerSide);
+	int kk = (int)(step % tilesPerSide);
+
+	*i = (int)(step / perRow);
+	*j = *i % 2 ? tilesPerSide - 1 - jj : jj;
+	*k = ((long)*i * tilesPerSide + jj) % 2 ? tilesPerSide - 1 - kk : kk;
+}
+
+int multiplyOutOfCore(const char* pathA, const char* pathB, const char* pathC, long memoryBudget, int tileSize)
+{
+	TileSource sourceA, sourceB;
+
+	if (openTileSource(&sourceA, pathA) != 0)
+		return -1;
+
+	if (openTileSource(&sourceB, pathB) != 0)
+	{
+		closeTileSource(&sourceA);
+		return -1;
+	}
+
+	if (sourceA.header.elementType != sourceB.header.elementType || sourceA.dimension != sourceB.dimension)
+	{
+		printf("Matrix files do not match\n");
+		closeTileSource(&sourceA);
+		closeTileSource(&sourceB);
+		return -1;
+	}
+
+	ElementType type = (ElementType)sourceA.header.elementType;
+	const ElementInfo* info = &elementInfo[type];
+	int dimension = sourceA.dimension;
+	long paddedSide = (dimension + TILE_ALIGNMENT - 1) / TILE_ALIGNMENT * TILE_ALIGNMENT;
+
+	// operand tiles, the scheduler output, the C accumulator and the passes' partial sums have to fit in the budget
+	if (tileSize == BUDGET_TILE_SIZE)
+	{
+		tileSize = TILE_ALIGNMENT;
+
+		while (tileSize + TILE_ALIGNMENT <= paddedSide
+			&& (long)(tileSize + TILE_ALIGNMENT) * (tileSize + TILE_ALIGNMENT) * (MIN_CACHED_TILES * info->sizeA + 2 * info->sizeOut)
+				+ (long)PASSES_IN_FLIGHT * (tileSize + TILE_ALIGNMENT) * TILE_ALIGNMENT * info->sizeOut <= memoryBudget)
+			tileSize += TILE_ALIGNMENT;
+	}
+	else
+		tileSize = (tileSize + TILE_ALIGNMENT - 1) / TILE_ALIGNMENT * TILE_ALIGNMENT;
+
+	long tileArea = (long)tileSize * tileSize;
+	int tilesPerSide = (dimension + tileSize - 1) / tileSize;
+	long passBytes = (long)PASSES_IN_FLIGHT * tileSize * TILE_ALIGNMENT * info->sizeOut;
+	long numTiles = (memoryBudget - 2 * tileArea * info->sizeOut - passBytes) / (tileArea * info->sizeA);
+
+	if (numTiles < MIN_CACHED_TILES)
+		numTiles = MIN_CACHED_TILES;
+
+	if (numTiles > 2L * tilesPerSide * tilesPerSide)
+		numTiles = 2L * tilesPerSide * tilesPerSide;
+
+	// the product is written out row major in the accumulator type
+	MatrixFileHeader headerC;
+	int fdC = createMatrixFile(pathC, info->outType, dimension, NULL, &headerC);
+
+	if (fdC < 0)
+	{
+		closeTileSource(&sourceA);
+		closeTileSource(&sourceB);
+		return -1;
+	}
+
+	TileCache cache;
+	cache.numTiles = (int)numTiles;
+	cache.tileSize = tileSize;
+	cache.layout = createLayout(layoutTiled, tileSize, TILE_ALIGNMENT, info->sizeA);
+	cache.clock = 0;
+	cache.failed = 0;
+	cache.tiles = (CachedTile*)calloc(cache.numTiles, sizeof(CachedTile));
+
+	if (cache.tiles == NULL || pthread_mutex_init(&(cache.lock), NULL) != 0 || pthread_cond_init(&(cache.loaded), NULL) != 0)
+	{
+		printf("Cannot create the tile cache\n");
+		exit(-1);
+	}
+
+	for (int i = 0; i < cache.numTiles; i++)
+	{
+		cache.tiles[i].cache = &cache;
+		cache.tiles[i].data = aligned_alloc(64, tileArea * info->sizeA);
+
+		if (cache.tiles[i].data == NULL)
+		{
+			printf("Out of memory\n");
+			exit(-1);
+		}
+	}
+
+	cache.ioPool = createThreadPool(IO_THREADS, cache.numTiles);
+
+	// one in memory scheduler multiplies each pair of tiles, on one cpu pool for the whole product
+	ThreadPool* cpuPool = createThreadPool(MAX_CPU_THREADS, MAX_CPU_THREADS);
+	Scheduler* scheduler = createTypedScheduler(NULL, NULL, tileSize, type);
+
+	setSchedulerLayout(scheduler, cache.layout, cache.layout);
+	setSchedulerThreadPool(scheduler, cpuPool);
+	char* sumC = (char*)aligned_alloc(64, tileArea * info->sizeOut);
+
+	if (sumC == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
+	long steps = (long)tilesPerSide * tilesPerSide * tilesPerSide;
+	int status = 0;
+
+	for (long step = 0; step < steps && status == 0; step++)
+	{
+		int i, j, k;
+		stepTiles(step, tilesPerSide, &i, &j, &k);
+
+		// start reading the next steps' tiles while this one computes
+		for (long ahead = step + 1; ahead <= step + PREFETCH_DEPTH && ahead < steps; ahead++)
+		{
+			int aheadI, aheadJ, aheadK;
+			stepTiles(ahead, tilesPerSide, &aheadI, &aheadJ, &aheadK);
+
+			acquireTile(&cache, &sourceA, aheadI, aheadK, 0);
+			acquireTile(&cache, &sourceB, aheadK, aheadJ, 0);
+		}
+
+		CachedTile* tileA = acquireTile(&cache, &sourceA, i, k, 1);
+		CachedTile* tileB = acquireTile(&cache, &sourceB, k, j, 1);
+
+		if (cache.failed)
+		{
+			printf("Cannot read a tile\n");
+			status = -1;
+			break;
+		}
+
+		scheduler->A = tileA->data;
+		scheduler->B = tileB->data;
+		runScheduler(scheduler);
+
+		releaseTile(&cache, tileA);
+		releaseTile(&cache, tileB);
+
+		int kk = (int)(step % tilesPerSide);
+
+		if (kk == 0)
+			memcpy(sumC, scheduler->dataOut, tileArea * info->sizeOut);
+		else
+			addBlock(info->outType, sumC, scheduler->dataOut, tileArea);
+
+		// the C tile is complete so write the part inside the matrix
+		if (kk == tilesPerSide - 1)
+		{
+			int rows = dimension - i * tileSize < tileSize ? dimension - i * tileSize : tileSize;
+			int cols = dimension - j * tileSize < tileSize ? dimension - j * tileSize : tileSize;
+
+			for (int y = 0; y < rows && status == 0; y++)
+				if (writeAll(fdC, &sumC[(long)y * tileSize * info->sizeOut], (size_t)cols * info->sizeOut,
+					headerC.payloadOffset + ((long)(i * tileSize + y) * dimension + j * tileSize) * info->sizeOut) != 0)
+				{
+					printf("Cannot write %s\n", pathC);
+					status = -1;
+				}
+		}
+	}
+
+	// let outstanding prefetches finish before their slots go away
+	destroyThreadPool(cache.ioPool, shutdown);
+
+	for (int i = 0; i < cache.numTiles; i++)
+		free(cache.tiles[i].data);
+
+	free(cache.tiles);
+	pthread_mutex_destroy(&(cache.lock));
+	pthread_cond_destroy(&(cache.loaded));
+
+	free(sumC);
+	deleteScheduler(scheduler);
+	destroyThreadPool(cpuPool, shutdown);
+	deleteLayout(cache.layout);
+
+	closeTileSource(&sourceA);
+	closeTileSource(&sourceB);
+
+	if (close(fdC) != 0)
+		status = -1;
+
+	return status;
+}
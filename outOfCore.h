@@ -0,0 +1,11 @@
+#ifndef OUT_OF_CORE_H
+#define OUT_OF_CORE_H
+
+// pick the tile size from the memory budget when passed as the tile size
+#define BUDGET_TILE_SIZE 0
+
+// multiply two matrix files that do not fit in memory, keeping at most memoryBudget bytes of tiles resident
+// C is written to pathC as a row major matrix file of the accumulator type, returns 0 on success
+int multiplyOutOfCore(const char* pathA, const char* pathB, const char* pathC, long memoryBudget, int tileSize);
+
+#endif
@@ -1,41 +1,1079 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "scheduler.h"
 #include "threadPool.h"
 #include "mMultGPU.h"
 #include "mMultCPU.h"
+#include "blockSum.h"
 
-#define MAX_CPU_THREADS 40
 #define MAX_GPU_THREADS 1
 #define BLOCK_SIZE 64
+#define SPARSE_JOBS_PER_THREAD 4
+#define SKINNY_JOBS_PER_THREAD 4
+#define SKINNY_ROW_ALIGN 4
+#define BIT_JOBS_PER_THREAD 4
+#define LOW_RANK_JOBS_PER_THREAD 4
+#define FOUR_RUSSIANS_MIN 256 // smaller products fit in one panel, the popcount kernel spreads them over the threads
+#define FOUR_RUSSIANS_ROWS 256 // rows sharing one set of tables
 
 #define ENABLE_GPU
 
 ThreadPool* gpuThreadPool;
 
+#ifndef DISABLE_GPU
+// hand a full batch to the gpu, the batch is kept when the gpu queue is full
+static int submitGPUBatch(GPUBatch** batch)
+{
+	if (*batch == NULL || (*batch)->count == 0)
+		return 0;
+
+	int status = addJob(gpuThreadPool, multiplyGPU, (void*)*batch);
+
+	if (status != queueFull)
+		*batch = NULL;
+
+	return status;
+}
+
+// add a pass to the batch being built, returns queueFull if the pass could not be taken
+static int batchGPU(GPUBatch** batch, SchedPass* schedPass)
+{
+	if (*batch != NULL && (*batch)->count == GPU_BATCH_SIZE && submitGPUBatch(batch) == queueFull)
+		return queueFull;
+
+	if (*batch == NULL)
+	{
+		*batch = (GPUBatch*)malloc(sizeof(GPUBatch));
+
+		if (*batch == NULL)
+			return queueFull;
+
+		(*batch)->count = 0;
+	}
+
+	(*batch)->passes[(*batch)->count++] = schedPass;
+
+	// send it off as soon as it fills up
+	if ((*batch)->count == GPU_BATCH_SIZE)
+		submitGPUBatch(batch);
+
+	return 0;
+}
+#endif
+
 Scheduler* createScheduler(int* A, int* B, int dimension)
 {
-	Scheduler* sched = (Scheduler*)malloc(sizeof(Scheduler));
+	return createTypedScheduler(A, B, dimension, typeInt32);
+}
+
+Scheduler* createTypedScheduler(void* A, void* B, int dimension, ElementType type)
+{
+	return createRectScheduler(A, B, dimension, dimension, type);
+}
+
+// a scheduler with every option off and no output buffer yet
+static Scheduler* newScheduler(void* A, void* B, int dimension, int columns, ElementType type)
+{
+	Scheduler* sched = (Scheduler*)malloc(sizeof(Scheduler));
+
+	if (sched == NULL)
+	{
+		printf("Not enough memory to store scheduler / output\n");
+		exit(-1);
+	}
+
+	sched->A = A;
+	sched->B = B;
+	sched->type = type;
+	sched->accumulate = accumulateNative;
+	sched->dimension = dimension;
+	sched->columns = columns;
+	sched->blockSize = BLOCK_SIZE;
+	sched->layoutA = NULL;
+	sched->layoutB = NULL;
+	sched->layoutOut = NULL;
+	sched->sparseA = NULL;
+	sched->skipZeroTiles = 0;
+	sched->symmetric = 0;
+	sched->mirror = 0;
+	sched->structureA = (MatrixStructure){ structureDense, 0, 0 };
+	sched->structureB = (MatrixStructure){ structureDense, 0, 0 };
+	sched->bitA = NULL;
+	sched->bitB = NULL;
+	sched->semiring = semiringArithmetic;
+	sched->modulus = NULL;
+	sched->epilogue = NULL;
+	sched->dirtyRows = NULL;
+	sched->dirtyColumns = NULL;
+	sched->cache = NULL;
+	sched->cpuPool = NULL;
+	sched->dataOut = NULL;
+
+	return sched;
+}
+
+Scheduler* createRectScheduler(void* A, void* B, int dimension, int columns, ElementType type)
+{
+	if (columns != dimension && (columns < 1 || columns > SKINNY_COLUMNS))
+	{
+		printf("B needs %i or at most %i columns, not %i\n", dimension, SKINNY_COLUMNS, columns);
+		exit(-1);
+	}
+
+	Scheduler* sched = newScheduler(A, B, dimension, columns, type);
+	sched->dataOut = malloc((size_t)elementInfo[type].sizeOut * dimension * columns);
+
+	if (sched->dataOut == NULL)
+	{
+		printf("Not enough memory to store scheduler / output\n");
+		exit(-1);
+	}
+
+	return sched;
+}
+
+Scheduler* createSyrkScheduler(void* A, int dimension, ElementType type, int mirror)
+{
+	// the two sides of a uint8 product have different types
+	if (elementInfo[type].sizeA != elementInfo[type].sizeB || type == typeUInt8)
+	{
+		printf("%s cannot be multiplied by its own transpose\n", elementInfo[type].name);
+		exit(-1);
+	}
+
+	Scheduler* sched = createTypedScheduler(A, A, dimension, type);
+	sched->symmetric = 1;
+	sched->mirror = mirror;
+
+	return sched;
+}
+
+Scheduler* createBitScheduler(BitMatrix* A, BitMatrix* B)
+{
+	if (A->dimension != B->dimension)
+	{
+		printf("Bit matrices do not match\n");
+		exit(-1);
+	}
+
+	// C is stored as one row of words per row, which is what the columns and the 64 bit output describe
+	Scheduler* sched = newScheduler(NULL, NULL, A->dimension, A->wordsPerRow, typeInt64);
+	sched->bitA = A;
+	sched->bitB = B;
+	sched->dataOut = malloc(sizeof(uint64_t) * A->dimension * A->wordsPerRow);
+
+	if (sched->dataOut == NULL)
+	{
+		printf("Not enough memory to store scheduler / output\n");
+		exit(-1);
+	}
+
+	return sched;
+}
+
+Scheduler* createFileScheduler(MatrixFile* A, MatrixFile* B)
+{
+	if (A->type != B->type || A->dimension != B->dimension)
+	{
+		printf("Matrix files do not match\n");
+		exit(-1);
+	}
+
+	Scheduler* sched = createTypedScheduler(A->data, B->data, A->dimension, A->type);
+
+	// tiled payloads are handed to the jobs without packing
+	if (A->layout != NULL || B->layout != NULL)
+		setSchedulerLayout(sched, A->layout, B->layout);
+
+	return sched;
+}
+
+Scheduler* createSparseScheduler(SparseMatrix* A, void* B)
+{
+	Scheduler* sched = createTypedScheduler(NULL, B, A->dimension, A->type);
+	sched->sparseA = A;
+
+	return sched;
+}
+
+static int accumulatorSize(Scheduler* scheduler)
+{
+	return scheduler->accumulate == accumulateNative ? elementInfo[scheduler->type].sizeOut : sizeof(int64_t);
+}
+
+int schedulerOutputSize(Scheduler* scheduler)
+{
+	return scheduler->accumulate == accumulateSaturate ? sizeof(int32_t) : accumulatorSize(scheduler);
+}
+
+// the type dataOut is stored in
+static ElementType outputType(Scheduler* scheduler)
+{
+	return scheduler->accumulate == accumulateNative ? elementInfo[scheduler->type].outType
+		: scheduler->accumulate == accumulateWide ? typeInt64 : typeInt32;
+}
+
+void setSchedulerAccumulate(Scheduler* scheduler, AccumulateMode accumulate)
+{
+	if (accumulate == accumulateSaturate && scheduler->epilogue != NULL)
+	{
+		printf("Saturated products take no epilogue\n");
+		exit(-1);
+	}
+
+	if (accumulate != accumulateNative && (scheduler->type != typeInt32 || scheduler->sparseA != NULL
+		|| scheduler->columns <= SKINNY_COLUMNS || scheduler->semiring != semiringArithmetic || scheduler->modulus != NULL))
+	{
+		printf("Only int32 operands can be accumulated in int64\n");
+		exit(-1);
+	}
+
+	int previousSize = schedulerOutputSize(scheduler);
+	scheduler->accumulate = accumulate;
+
+	// int64 output needs a bigger buffer
+	if (schedulerOutputSize(scheduler) != previousSize)
+	{
+		free(scheduler->dataOut);
+		scheduler->dataOut = malloc((size_t)schedulerOutputSize(scheduler) * scheduler->dimension * scheduler->columns);
+
+		if (scheduler->dataOut == NULL)
+		{
+			printf("Not enough memory to store scheduler / output\n");
+			exit(-1);
+		}
+	}
+}
+
+void setSchedulerSemiring(Scheduler* scheduler, Semiring semiring)
+{
+	// only the tiled path has semiring kernels
+	if (semiring != semiringArithmetic && (getSemiringKernel(scheduler->type, semiring) == NULL
+		|| scheduler->accumulate != accumulateNative || scheduler->modulus != NULL || scheduler->sparseA != NULL || scheduler->bitA != NULL
+		|| scheduler->columns <= SKINNY_COLUMNS || scheduler->epilogue != NULL))
+	{
+		printf("This semiring cannot multiply %s matrices of size %i here\n", elementInfo[scheduler->type].name, scheduler->dimension);
+		exit(-1);
+	}
+
+	scheduler->semiring = semiring;
+}
+
+void setSchedulerModulus(Scheduler* scheduler, uint32_t modulus)
+{
+	free(scheduler->modulus);
+	scheduler->modulus = NULL;
+
+	if (modulus == 0)
+		return;
+
+	// only the tiled int32 path reduces
+	if (scheduler->type != typeInt32 || scheduler->accumulate != accumulateNative || scheduler->semiring != semiringArithmetic
+		|| scheduler->sparseA != NULL || scheduler->bitA != NULL || scheduler->columns <= SKINNY_COLUMNS || scheduler->epilogue != NULL)
+	{
+		printf("Only square int32 products can be taken mod a prime\n");
+		exit(-1);
+	}
+
+	scheduler->modulus = (Modulus*)malloc(sizeof(Modulus));
+
+	if (scheduler->modulus == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
+	if (!initModulus(scheduler->modulus, modulus))
+	{
+		printf("The modulus %u has to be odd and below 2^31\n", modulus);
+		exit(-1);
+	}
+}
+
+void setSchedulerEpilogue(Scheduler* scheduler, const Epilogue* epilogue)
+{
+	free(scheduler->epilogue);
+	scheduler->epilogue = NULL;
+
+	if (epilogue == NULL || epilogue->ops == 0)
+		return;
+
+	ElementType outType = outputType(scheduler);
+
+	// the reductions that are not a plain sum have no fused write, and a bias breaks the mirrored triangle
+	if (scheduler->bitA != NULL || scheduler->semiring != semiringArithmetic || scheduler->modulus != NULL
+		|| scheduler->accumulate == accumulateSaturate || ((epilogue->ops & epilogueBias) && scheduler->mirror)
+		|| ((epilogue->ops & epilogueRequantize) && (outType == typeFloat32 || outType == typeFloat64)))
+	{
+		printf("This epilogue cannot be applied to a %s product here\n", elementInfo[scheduler->type].name);
+		exit(-1);
+	}
+
+	scheduler->epilogue = (Epilogue*)malloc(sizeof(Epilogue));
+
+	if (scheduler->epilogue == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
+	*scheduler->epilogue = *epilogue;
+}
+
+void setSchedulerDirty(Scheduler* scheduler, const int* rows, int rowCount, const int* columns, int columnCount)
+{
+	// GF(2) products are always recomputed whole
+	if (scheduler->bitA != NULL)
+	{
+		printf("Bit matrix products cannot be refreshed in part\n");
+		exit(-1);
+	}
+
+	free(scheduler->dirtyRows);
+	free(scheduler->dirtyColumns);
+
+	scheduler->dirtyRows = (char*)calloc(scheduler->dimension, 1);
+	scheduler->dirtyColumns = (char*)calloc(scheduler->columns, 1);
+
+	if (scheduler->dirtyRows == NULL || scheduler->dirtyColumns == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
+	for (int i = 0; i < rowCount; i++)
+	{
+		if (rows[i] < 0 || rows[i] >= scheduler->dimension)
+		{
+			printf("Row %i is outside the matrix\n", rows[i]);
+			exit(-1);
+		}
+
+		scheduler->dirtyRows[rows[i]] = 1;
+	}
+
+	for (int i = 0; i < columnCount; i++)
+	{
+		if (columns[i] < 0 || columns[i] >= scheduler->columns)
+		{
+			printf("Column %i is outside the matrix\n", columns[i]);
+			exit(-1);
+		}
+
+		scheduler->dirtyColumns[columns[i]] = 1;
+	}
+}
+
+// every run consumes the dirty sets, the one after recomputes everything again
+static void clearDirty(Scheduler* scheduler)
+{
+	free(scheduler->dirtyRows);
+	free(scheduler->dirtyColumns);
+
+	scheduler->dirtyRows = NULL;
+	scheduler->dirtyColumns = NULL;
+}
+
+// C = X * Y (clear) or C += X * Y split into row panels across the pool, X has inner columns and Y is inner x columns
+static void runLowRank(ElementType type, const void* X, const void* Y, void* C, int rows, int inner, int columns, int clear)
+{
+	int jobs = MAX_CPU_THREADS * LOW_RANK_JOBS_PER_THREAD;
+	int panelRows = (rows + jobs - 1) / jobs;
+
+	ThreadPool* cpuThreadPool = createThreadPool(MAX_CPU_THREADS, MAX_CPU_THREADS);
+
+	for (int beginRow = 0; beginRow < rows; beginRow += panelRows)
+	{
+		LowRankPass* lowRankPass = (LowRankPass*)malloc(sizeof(LowRankPass));
+
+		if (lowRankPass == NULL)
+		{
+			printf("Out of memory\n");
+			exit(-1);
+		}
+
+		lowRankPass->type = type;
+		lowRankPass->X = X;
+		lowRankPass->Y = Y;
+		lowRankPass->C = C;
+		lowRankPass->inner = inner;
+		lowRankPass->columns = columns;
+		lowRankPass->clear = clear;
+		lowRankPass->beginRow = beginRow;
+		lowRankPass->endRow = beginRow + panelRows < rows ? beginRow + panelRows : rows;
+
+		// wait for room in the queue
+		while (addJob(cpuThreadPool, multiplyRank, (void*)lowRankPass) == queueFull);
+	}
+
+	// wait for the threads to exit
+	destroyThreadPool(cpuThreadPool, shutdown);
+}
+
+void updateSchedulerLowRank(Scheduler* scheduler, int updateA, const void* U, const void* V, int rank)
+{
+	// the update is a plain sum into dataOut, anything that reshapes the product or its output cannot take it
+	if (getRankKernel(scheduler->type) == NULL || rank < 1 || scheduler->accumulate != accumulateNative
+		|| scheduler->semiring != semiringArithmetic || scheduler->modulus != NULL || scheduler->epilogue != NULL
+		|| scheduler->sparseA != NULL || scheduler->bitA != NULL || scheduler->symmetric
+		|| scheduler->layoutA != NULL || scheduler->layoutB != NULL || scheduler->layoutOut != NULL
+		|| scheduler->structureA.type != structureDense || scheduler->structureB.type != structureDense)
+	{
+		printf("A rank %i update needs a plain row major %s product\n", rank, elementInfo[scheduler->type].name);
+		exit(-1);
+	}
+
+	int dimension = scheduler->dimension;
+	int columns = scheduler->columns;
+	int elementSize = elementInfo[scheduler->type].sizeOut;
+
+	// (A + U * V) * B adds U * (V * B) and A * (B + U * V) adds (A * U) * V, both only rank wide in the middle
+	int scratchRows = updateA ? rank : dimension;
+	int scratchColumns = updateA ? columns : rank;
+	void* scratch = malloc((size_t)elementSize * scratchRows * scratchColumns);
+
+	if (scratch == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
+	if (updateA)
+	{
+		runLowRank(scheduler->type, V, scheduler->B, scratch, rank, dimension, columns, 1);
+		runLowRank(scheduler->type, U, scratch, scheduler->dataOut, dimension, rank, columns, 0);
+	}
+	else
+	{
+		runLowRank(scheduler->type, scheduler->A, U, scratch, dimension, dimension, rank, 1);
+		runLowRank(scheduler->type, scratch, V, scheduler->dataOut, dimension, rank, columns, 0);
+	}
+
+	free(scratch);
+}
+
+void setSchedulerCache(Scheduler* scheduler, MatrixCache* cache)
+{
+	scheduler->cache = cache;
+}
+
+void setSchedulerThreadPool(Scheduler* scheduler, ThreadPool* pool)
+{
+	scheduler->cpuPool = pool;
+}
+
+// a pool set by the caller is kept across runs, otherwise each run starts its own
+static ThreadPool* startCPUPool(Scheduler* scheduler)
+{
+	return scheduler->cpuPool != NULL ? scheduler->cpuPool : createThreadPool(MAX_CPU_THREADS, MAX_CPU_THREADS);
+}
+
+static void finishCPUPool(Scheduler* scheduler, ThreadPool* pool)
+{
+	if (pool == scheduler->cpuPool)
+		waitTillIdle(pool);
+	else
+		destroyThreadPool(pool, shutdown);
+}
+
+static uint64_t hashOperand(const void* data, MatrixLayout* layout, int elementSize, int rows, int columns)
+{
+	long elements = layout != NULL ? layoutSize(layout) : (long)rows * columns;
+
+	return hashContents(data, (size_t)elements * elementSize, 0);
+}
+
+static size_t outputBytes(Scheduler* scheduler)
+{
+	long elements = scheduler->layoutOut != NULL ? layoutSize(scheduler->layoutOut) : (long)scheduler->dimension * scheduler->columns;
+
+	return (size_t)schedulerOutputSize(scheduler) * elements;
+}
+
+// everything besides the operands' contents that the output depends on
+static void resultKey(Scheduler* scheduler, CacheKey* key)
+{
+	const ElementInfo* info = &elementInfo[scheduler->type];
+	MatrixLayout* layouts[3] = { scheduler->layoutA, scheduler->layoutB, scheduler->layoutOut };
+	Epilogue* epilogue = scheduler->epilogue;
+	int64_t settings[32];
+	int count = 0;
+
+	settings[count++] = scheduler->type;
+	settings[count++] = scheduler->accumulate;
+	settings[count++] = scheduler->semiring;
+	settings[count++] = scheduler->modulus != NULL ? scheduler->modulus->modulus : 0;
+	settings[count++] = scheduler->dimension;
+	settings[count++] = scheduler->columns;
+	settings[count++] = scheduler->symmetric;
+	settings[count++] = scheduler->mirror;
+
+	for (int i = 0; i < 3; i++)
+	{
+		settings[count++] = layouts[i] != NULL ? layouts[i]->type : layoutRowMajor;
+		settings[count++] = layouts[i] != NULL ? layouts[i]->tileSize : 0;
+	}
+
+	// band widths only mean something for banded operands
+	settings[count++] = scheduler->structureA.type;
+	settings[count++] = scheduler->structureA.type == structureBanded ? scheduler->structureA.lower : 0;
+	settings[count++] = scheduler->structureA.type == structureBanded ? scheduler->structureA.upper : 0;
+	settings[count++] = scheduler->structureB.type;
+	settings[count++] = scheduler->structureB.type == structureBanded ? scheduler->structureB.lower : 0;
+	settings[count++] = scheduler->structureB.type == structureBanded ? scheduler->structureB.upper : 0;
+
+	// the epilogue field by field, its padding and bias pointer say nothing about the result
+	if (epilogue != NULL)
+	{
+		double scalars[4] = { epilogue->scale, epilogue->lower, epilogue->upper, epilogue->requantScale };
+
+		settings[count++] = epilogue->ops;
+		settings[count++] = epilogue->zeroPoint;
+
+		for (int i = 0; i < 4; i++)
+			memcpy(&settings[count++], &scalars[i], sizeof(double));
+	}
+
+	key->kind = cachedResult;
+	key->hashA = hashOperand(scheduler->A, scheduler->layoutA, info->sizeA, scheduler->dimension, scheduler->dimension);
+	key->hashB = scheduler->symmetric ? 0 : hashOperand(scheduler->B, scheduler->layoutB, info->sizeB, scheduler->dimension, scheduler->columns);
+	key->hashSettings = hashContents(settings, sizeof(int64_t) * count, 0);
+
+	// the bias values themselves
+	if (epilogue != NULL && (epilogue->ops & epilogueBias))
+		key->hashSettings = hashContents(epilogue->bias, (size_t)elementInfo[outputType(scheduler)].sizeOut * scheduler->columns, key->hashSettings);
+}
+
+void setSchedulerSkipZeroTiles(Scheduler* scheduler, int skipZeroTiles)
+{
+	scheduler->skipZeroTiles = skipZeroTiles;
+}
+
+void setSchedulerStructure(Scheduler* scheduler, MatrixStructure* structureA, MatrixStructure* structureB)
+{
+	scheduler->structureA = (MatrixStructure){ structureDense, 0, 0 };
+	scheduler->structureB = (MatrixStructure){ structureDense, 0, 0 };
+
+	if (structureA != NULL)
+		scheduler->structureA = *structureA;
+
+	if (structureB != NULL)
+		scheduler->structureB = *structureB;
+}
+
+void setSchedulerLayout(Scheduler* scheduler, MatrixLayout* layoutA, MatrixLayout* layoutB)
+{
+	scheduler->layoutA = layoutA != NULL && layoutA->type != layoutRowMajor ? layoutA : NULL;
+	scheduler->layoutB = layoutB != NULL && layoutB->type != layoutRowMajor ? layoutB : NULL;
+
+	// work on the stored tiles directly so no packing is needed
+	if (scheduler->layoutA != NULL)
+		scheduler->blockSize = scheduler->layoutA->tileSize;
+	else if (scheduler->layoutB != NULL)
+		scheduler->blockSize = scheduler->layoutB->tileSize;
+	else
+		scheduler->blockSize = BLOCK_SIZE;
+
+	// the gpu shader works in 16 x 16 groups
+	if (scheduler->blockSize % 16 != 0 || scheduler->dimension % scheduler->blockSize != 0)
+	{
+		printf("Tile size %i does not fit a matrix of size %i\n", scheduler->blockSize, scheduler->dimension);
+		exit(-1);
+	}
+}
+
+void setSchedulerOutputLayout(Scheduler* scheduler, MatrixLayout* layoutOut)
+{
+	scheduler->layoutOut = layoutOut != NULL && layoutOut->type != layoutRowMajor ? layoutOut : NULL;
+}
+
+// where the output tile starting at (row, col) goes and how far apart its rows are
+static char* outputTile(Scheduler* scheduler, int row, int col, int* outputWidth)
+{
+	char* dataOut = (char*)scheduler->dataOut;
+	int sizeOut = schedulerOutputSize(scheduler);
+	int blockSize = scheduler->blockSize;
+
+	if (scheduler->layoutOut != NULL)
+	{
+		*outputWidth = blockSize;
+		return &dataOut[tileOffset(scheduler->layoutOut, row / blockSize, col / blockSize) * sizeOut];
+	}
+
+	*outputWidth = scheduler->dimension;
+	return &dataOut[((long)row * scheduler->dimension + col) * sizeOut];
+}
+
+static void* fetchTile(void* data, MatrixLayout* layout, const MatrixStructure* structure, int elementSize, int dimension,
+	int blockSize, int row, int col, int* owned)
+{
+	char* matrix = (char*)data;
+	TileCoverage coverage = structureCoverage(structure, row, col, blockSize);
+
+	// tiles of the right size are already contiguous so hand them out as is, unless they need masking
+	if (layout != NULL && layout->tileSize == blockSize && coverage == tileFull)
+	{
+		*owned = 0;
+		return &matrix[tileOffset(layout, row / blockSize, col / blockSize) * elementSize];
+	}
+
+	char* tile = (char*)malloc((size_t)elementSize * blockSize * blockSize);
+
+	if (tile == NULL)
+		return NULL;
+
+	*owned = 1;
+
+	// gather the tile
+	for (int y = 0; y < blockSize; y++)
+	{
+		if (layout == NULL)
+			memcpy(&tile[y * blockSize * elementSize], &matrix[((long)(row + y) * dimension + col) * elementSize],
+				(size_t)elementSize * blockSize);
+		else
+			for (int x = 0; x < blockSize; x++)
+				memcpy(&tile[(y * blockSize + x) * elementSize],
+					&matrix[elementOffset(layout, row + y, col + x) * elementSize], elementSize);
+	}
+
+	// tiles on the edge of a triangle or band drop what lies outside it
+	if (coverage == tilePartial)
+		maskToStructure(structure, tile, elementSize, blockSize, row, col);
+
+	return tile;
+}
+
+static int bytesAreZero(const char* bytes, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		if (bytes[i] != 0)
+			return 0;
+
+	return 1;
+}
+
+// negative zero counts as nonzero, which only costs a product that could have been skipped
+static int tileIsZero(void* data, MatrixLayout* layout, int elementSize, int dimension, int blockSize, int row, int col)
+{
+	char* matrix = (char*)data;
+
+	if (layout != NULL && layout->tileSize == blockSize)
+		return bytesAreZero(&matrix[tileOffset(layout, row / blockSize, col / blockSize) * elementSize],
+			(size_t)elementSize * blockSize * blockSize);
+
+	for (int y = 0; y < blockSize; y++)
+	{
+		if (layout == NULL)
+		{
+			if (!bytesAreZero(&matrix[((long)(row + y) * dimension + col) * elementSize], (size_t)elementSize * blockSize))
+				return 0;
+		}
+		else
+			for (int x = 0; x < blockSize; x++)
+				if (!bytesAreZero(&matrix[elementOffset(layout, row + y, col + x) * elementSize], elementSize))
+					return 0;
+	}
+
+	return 1;
+}
+
+// one bit per tile, set when the tile holds a nonzero value
+static unsigned char* buildTileBitmap(void* data, MatrixLayout* layout, int elementSize, int dimension, int blockSize)
+{
+	int blocksPerSide = dimension / blockSize;
+	unsigned char* bitmap = (unsigned char*)calloc(((size_t)blocksPerSide * blocksPerSide + 7) / 8, 1);
+
+	if (bitmap == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
+	for (int tile = 0; tile < blocksPerSide * blocksPerSide; tile++)
+		if (!tileIsZero(data, layout, elementSize, dimension, blockSize,
+			tile / blocksPerSide * blockSize, tile % blocksPerSide * blockSize))
+			bitmap[tile / 8] |= 1 << (tile % 8);
+
+	return bitmap;
+}
+
+static int tileBit(unsigned char* bitmap, int tile)
+{
+	return bitmap == NULL || (bitmap[tile / 8] >> (tile % 8)) & 1;
+}
+
+// a tile takes part when it holds a nonzero value and lies at least partly inside the structure
+static int tileUsed(unsigned char* bitmap, const MatrixStructure* structure, int blocksPerSide, int blockSize, int tileRow, int tileCol)
+{
+	return tileBit(bitmap, tileRow * blocksPerSide + tileCol)
+		&& structureCoverage(structure, tileRow * blockSize, tileCol * blockSize, blockSize) != tileEmpty;
+}
 
-	// set data out
-	sched->A = A;
-	sched->B = B;
-	sched->dimension = dimension;
-	sched->dataOut = (int*)malloc(sizeof(int) * dimension * dimension);
+// the bitmap of A^T for symmetric products
+static unsigned char* transposeTileBitmap(unsigned char* bitmap, int blocksPerSide)
+{
+	unsigned char* transposed = (unsigned char*)calloc(((size_t)blocksPerSide * blocksPerSide + 7) / 8, 1);
 
-	if (sched->dataOut == NULL || sched == NULL)
+	if (transposed == NULL)
 	{
-		printf("Not enough memory to store scheduler / output\n");
+		printf("Out of memory\n");
 		exit(-1);
 	}
 
-	return sched;
+	for (int row = 0; row < blocksPerSide; row++)
+		for (int col = 0; col < blocksPerSide; col++)
+			if (tileBit(bitmap, row * blocksPerSide + col))
+				transposed[(col * blocksPerSide + row) / 8] |= 1 << ((col * blocksPerSide + row) % 8);
+
+	return transposed;
 }
 
-void runScheduler(Scheduler* scheduler)
+// packed tiles of A and their transposes, kept until the whole symmetric product is done
+typedef struct
+{
+	int blocksPerSide;
+	void** tiles;
+	void** transposed;
+	int* owned; // the tile was packed rather than handed out of the layout
+} PanelCache;
+
+static PanelCache* createPanelCache(int blocksPerSide)
+{
+	PanelCache* cache = (PanelCache*)malloc(sizeof(PanelCache));
+
+	if (cache == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
+	cache->blocksPerSide = blocksPerSide;
+	cache->tiles = (void**)calloc((size_t)blocksPerSide * blocksPerSide, sizeof(void*));
+	cache->transposed = (void**)calloc((size_t)blocksPerSide * blocksPerSide, sizeof(void*));
+	cache->owned = (int*)calloc((size_t)blocksPerSide * blocksPerSide, sizeof(int));
+
+	if (cache->tiles == NULL || cache->transposed == NULL || cache->owned == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
+	return cache;
+}
+
+// tile (row, col) of A or its transpose, packed on first use, null when memory is short
+static void* panelTile(PanelCache* cache, Scheduler* scheduler, int row, int col, int transpose)
+{
+	int blockSize = scheduler->blockSize;
+	int elementSize = elementInfo[scheduler->type].sizeA;
+	int tile = row / blockSize * cache->blocksPerSide + col / blockSize;
+
+	if (cache->tiles[tile] == NULL)
+		cache->tiles[tile] = fetchTile(scheduler->A, scheduler->layoutA, &scheduler->structureA, elementSize, scheduler->dimension, blockSize,
+			row, col, &cache->owned[tile]);
+
+	if (!transpose || cache->tiles[tile] == NULL)
+		return cache->tiles[tile];
+
+	if (cache->transposed[tile] == NULL)
+	{
+		char* source = (char*)cache->tiles[tile];
+		char* transposed = (char*)malloc((size_t)elementSize * blockSize * blockSize);
+
+		if (transposed == NULL)
+			return NULL;
+
+		for (int y = 0; y < blockSize; y++)
+			for (int x = 0; x < blockSize; x++)
+				memcpy(&transposed[(x * blockSize + y) * elementSize], &source[(y * blockSize + x) * elementSize], elementSize);
+
+		cache->transposed[tile] = transposed;
+	}
+
+	return cache->transposed[tile];
+}
+
+static void deletePanelCache(PanelCache* cache)
+{
+	for (int tile = 0; tile < cache->blocksPerSide * cache->blocksPerSide; tile++)
+	{
+		if (cache->owned[tile])
+			free(cache->tiles[tile]);
+
+		free(cache->transposed[tile]);
+	}
+
+	free(cache->tiles);
+	free(cache->transposed);
+	free(cache->owned);
+	free(cache);
+}
+
+// copy the upper triangle of tiles into the lower one
+static void mirrorTiles(Scheduler* scheduler)
+{
+	int blockSize = scheduler->blockSize;
+	int dimension = scheduler->dimension;
+	int sizeOut = schedulerOutputSize(scheduler);
+	char* dataOut = (char*)scheduler->dataOut;
+
+	for (int row = 0; row < dimension; row++)
+		for (int col = (row / blockSize + 1) * blockSize; col < dimension; col++)
+			memcpy(&dataOut[((long)col * dimension + row) * sizeOut], &dataOut[((long)row * dimension + col) * sizeOut], sizeOut);
+}
+
+// split the rows so every job gets about the same number of stored entries, empty rows cost next to nothing
+static void runSparseScheduler(Scheduler* scheduler)
+{
+	SparseMatrix* A = scheduler->sparseA;
+	long entries = sparseEntries(A);
+	int jobs = MAX_CPU_THREADS * SPARSE_JOBS_PER_THREAD;
+	int beginRow = 0;
+
+	ThreadPool* cpuThreadPool = startCPUPool(scheduler);
+
+	for (int job = 1; beginRow < A->blockRows; job++)
+	{
+		long target = entries * job / jobs;
+		int endRow = beginRow + 1;
+
+		while (endRow < A->blockRows && A->rowStart[endRow] < target)
+			endRow++;
+
+		if (job >= jobs)
+			endRow = A->blockRows;
+
+		SparsePass* sparsePass = (SparsePass*)malloc(sizeof(SparsePass));
+
+		if (sparsePass == NULL)
+		{
+			printf("Out of memory\n");
+			exit(-1);
+		}
+
+		sparsePass->A = A;
+		sparsePass->B = scheduler->B;
+		sparsePass->C = scheduler->dataOut;
+		sparsePass->epilogue = scheduler->epilogue;
+		sparsePass->beginRow = beginRow;
+		sparsePass->endRow = endRow;
+
+		// wait for room in the queue
+		while (addJob(cpuThreadPool, multiplySparse, (void*)sparsePass) == queueFull);
+
+		beginRow = endRow;
+	}
+
+	// wait for the threads to exit
+	finishCPUPool(scheduler, cpuThreadPool);
+}
+
+// a skinny B would leave the tiles nearly empty, so stream A once in row panels instead
+static void runSkinnyScheduler(Scheduler* scheduler)
+{
+	int dimension = scheduler->dimension;
+	int columns = scheduler->columns;
+	int elementSize = elementInfo[scheduler->type].sizeB;
+	int elementSizeA = elementInfo[scheduler->type].sizeA;
+	const char* A = (const char*)scheduler->A;
+	const char* B = (const char*)scheduler->B;
+	char* maskedA = NULL;
+	char* transposed = NULL;
+
+	if (scheduler->layoutA != NULL || scheduler->layoutB != NULL)
+	{
+		printf("Skinny products need row major operands\n");
+		exit(-1);
+	}
+
+	// the kernels read whole rows so a triangular or banded A is masked into a copy
+	if (scheduler->structureA.type != structureDense)
+	{
+		maskedA = (char*)malloc((size_t)elementSizeA * dimension * dimension);
+
+		if (maskedA == NULL)
+		{
+			printf("Out of memory\n");
+			exit(-1);
+		}
+
+		for (int row = 0; row < dimension; row++)
+			for (int col = 0; col < dimension; col++)
+			{
+				long offset = ((long)row * dimension + col) * elementSizeA;
+
+				if (structureKeeps(&scheduler->structureA, row, col))
+					memcpy(&maskedA[offset], &A[offset], elementSizeA);
+				else
+					memset(&maskedA[offset], 0, elementSizeA);
+			}
+
+		A = maskedA;
+	}
+
+	// a single column is already contiguous and the transpose of A^T is A
+	if (scheduler->symmetric)
+		B = A;
+	else if (columns > 1 || scheduler->structureB.type != structureDense)
+	{
+		transposed = (char*)malloc((size_t)elementSize * columns * dimension);
+
+		if (transposed == NULL)
+		{
+			printf("Out of memory\n");
+			exit(-1);
+		}
+
+		for (int k = 0; k < dimension; k++)
+			for (int j = 0; j < columns; j++)
+			{
+				if (structureKeeps(&scheduler->structureB, k, j))
+					memcpy(&transposed[((long)j * dimension + k) * elementSize], &B[((long)k * columns + j) * elementSize], elementSize);
+				else
+					memset(&transposed[((long)j * dimension + k) * elementSize], 0, elementSize);
+			}
+
+		B = transposed;
+	}
+
+	// keep the panels a multiple of the kernel's row block
+	int jobs = MAX_CPU_THREADS * SKINNY_JOBS_PER_THREAD;
+	int panelRows = (dimension + jobs - 1) / jobs;
+	panelRows = (panelRows + SKINNY_ROW_ALIGN - 1) / SKINNY_ROW_ALIGN * SKINNY_ROW_ALIGN;
+
+	// a changed column of B reaches every row, as does a changed row of a symmetric A since it is also a column of A^T,
+	// otherwise only the panels holding a changed row of A are redone
+	int refreshAll = scheduler->dirtyRows == NULL || memchr(scheduler->dirtyColumns, 1, columns) != NULL
+		|| (scheduler->symmetric && memchr(scheduler->dirtyRows, 1, dimension) != NULL);
+
+	ThreadPool* cpuThreadPool = startCPUPool(scheduler);
+
+	for (int beginRow = 0; beginRow < dimension; beginRow += panelRows)
+	{
+		int endRow = beginRow + panelRows < dimension ? beginRow + panelRows : dimension;
+
+		if (!refreshAll && memchr(&scheduler->dirtyRows[beginRow], 1, endRow - beginRow) == NULL)
+			continue;
+
+		SkinnyPass* skinnyPass = (SkinnyPass*)malloc(sizeof(SkinnyPass));
+
+		if (skinnyPass == NULL)
+		{
+			printf("Out of memory\n");
+			exit(-1);
+		}
+
+		skinnyPass->type = scheduler->type;
+		skinnyPass->A = A;
+		skinnyPass->B = B;
+		skinnyPass->C = scheduler->dataOut;
+		skinnyPass->epilogue = scheduler->epilogue;
+		skinnyPass->dimension = dimension;
+		skinnyPass->columns = columns;
+		skinnyPass->beginRow = beginRow;
+		skinnyPass->endRow = endRow;
+
+		// wait for room in the queue
+		while (addJob(cpuThreadPool, multiplySkinny, (void*)skinnyPass) == queueFull);
+	}
+
+	// wait for the threads to exit
+	finishCPUPool(scheduler, cpuThreadPool);
+
+	free(maskedA);
+	free(transposed);
+}
+
+// the rows of C are split into panels, four russians panels are kept large enough to pay for their tables
+static void runBitScheduler(Scheduler* scheduler)
+{
+	BitMatrix* A = scheduler->bitA;
+	int dimension = A->dimension;
+	BitMethod method = dimension >= FOUR_RUSSIANS_MIN ? bitFourRussians : bitDot;
+	BitMatrix* B = method == bitDot ? transposeBitMatrix(scheduler->bitB) : scheduler->bitB;
+
+	int jobs = MAX_CPU_THREADS * BIT_JOBS_PER_THREAD;
+	int panelRows = (dimension + jobs - 1) / jobs;
+
+	if (method == bitFourRussians && panelRows < FOUR_RUSSIANS_ROWS)
+		panelRows = FOUR_RUSSIANS_ROWS;
+
+	ThreadPool* cpuThreadPool = startCPUPool(scheduler);
+
+	for (int beginRow = 0; beginRow < dimension; beginRow += panelRows)
+	{
+		BitPass* bitPass = (BitPass*)malloc(sizeof(BitPass));
+
+		if (bitPass == NULL)
+		{
+			printf("Out of memory\n");
+			exit(-1);
+		}
+
+		bitPass->method = method;
+		bitPass->A = A->words;
+		bitPass->B = B->words;
+		bitPass->C = (uint64_t*)scheduler->dataOut;
+		bitPass->dimension = dimension;
+		bitPass->words = A->wordsPerRow;
+		bitPass->beginRow = beginRow;
+		bitPass->endRow = beginRow + panelRows < dimension ? beginRow + panelRows : dimension;
+
+		// wait for room in the queue
+		while (addJob(cpuThreadPool, multiplyBits, (void*)bitPass) == queueFull);
+	}
+
+	// wait for the threads to exit
+	finishCPUPool(scheduler, cpuThreadPool);
+
+	if (B != scheduler->bitB)
+		deleteBitMatrix(B);
+}
+
+static void runProduct(Scheduler* scheduler)
 {
-	int blocksPerSide = scheduler->dimension / BLOCK_SIZE;
+	// only the dense tiled path writes whole tiles, and mirroring copies across row major rows
+	if (scheduler->layoutOut != NULL && (scheduler->bitA != NULL || scheduler->sparseA != NULL
+		|| scheduler->columns <= SKINNY_COLUMNS || scheduler->mirror || scheduler->layoutOut->tileSize != scheduler->blockSize))
+	{
+		printf("An output layout needs a dense tiled product with %i x %i tiles\n", scheduler->blockSize, scheduler->blockSize);
+		exit(-1);
+	}
+
+	if (scheduler->bitA != NULL)
+	{
+		runBitScheduler(scheduler);
+		clearDirty(scheduler);
+		return;
+	}
+
+	if (scheduler->sparseA != NULL)
+	{
+		runSparseScheduler(scheduler);
+		clearDirty(scheduler);
+		return;
+	}
+
+	if (scheduler->columns <= SKINNY_COLUMNS)
+	{
+		runSkinnyScheduler(scheduler);
+		clearDirty(scheduler);
+		return;
+	}
+
+	// zero is only the identity of plus for these two, skipped tiles would read as zero
+	if ((scheduler->semiring == semiringMinPlus || scheduler->semiring == semiringMaxPlus)
+		&& (scheduler->skipZeroTiles || scheduler->structureA.type != structureDense || scheduler->structureB.type != structureDense))
+	{
+		printf("Tiles cannot be skipped for min-plus or max-plus products\n");
+		exit(-1);
+	}
+
+	int blockSize = scheduler->blockSize;
+	int blocksPerSide = scheduler->dimension / blockSize;
 	int jobs = blocksPerSide * blocksPerSide;
+	int outputWidth = scheduler->dimension;
 	int completeJobs = 0;
 
 	int remBlocks = 0;
@@ -44,13 +1082,103 @@ void runScheduler(Scheduler* scheduler)
 
 	int colBOffset = 0;
 
-	int* dataA = NULL, *dataB = NULL, *dataC = NULL;
+	const ElementInfo* info = &elementInfo[scheduler->type];
+	char* dataOut = (char*)scheduler->dataOut;
+	int sizeAccum = accumulatorSize(scheduler);
+	int sizeOut = schedulerOutputSize(scheduler);
+	void* dataA = NULL, *dataB = NULL;
+	char* dataC = NULL;
+	int ownsA = 0, ownsB = 0;
+	int groupSize = 0, groupMember = 0;
 	int* groupProgress = NULL;
+	int* leaderWaiting = NULL;
 	pthread_mutex_t* groupLock = NULL;
 	pthread_cond_t* groupSignal = NULL;
 
+	// B is packed into whole tiles once and kept in the cache, so a repeated B is handed out without packing
+	void* operandB = scheduler->B;
+	MatrixLayout* layoutB = scheduler->layoutB;
+	void* cachedB = NULL;
+	int ownsCachedB = 0;
+
+	if (scheduler->cache != NULL && layoutB == NULL && !scheduler->symmetric)
+	{
+		int64_t settings[4] = { scheduler->type, scheduler->dimension, scheduler->columns, blockSize };
+		CacheKey key = { cachedPanels, 0, hashOperand(scheduler->B, NULL, info->sizeB, scheduler->dimension, scheduler->columns),
+			hashContents(settings, sizeof(settings), 0) };
+
+		cachedB = lookupCache(scheduler->cache, &key, &layoutB);
+
+		if (cachedB == NULL)
+		{
+			layoutB = createLayout(layoutTiled, scheduler->dimension, blockSize, info->sizeB);
+			cachedB = allocateLayoutMatrix(layoutB, info->sizeB);
+			convertToLayout(layoutB, scheduler->B, cachedB, info->sizeB);
+
+			// over the budget it still saves the packing within this run
+			ownsCachedB = !storeCache(scheduler->cache, &key, cachedB, layoutSize(layoutB) * info->sizeB, layoutB);
+		}
+
+		operandB = cachedB;
+	}
+
+	// tiles with no nonzero value are left out of the products
+	unsigned char* nonzeroA = NULL, *nonzeroB = NULL;
+
+	if (scheduler->skipZeroTiles)
+	{
+		nonzeroA = buildTileBitmap(scheduler->A, scheduler->layoutA, info->sizeA, scheduler->dimension, blockSize);
+
+		if (scheduler->symmetric)
+			nonzeroB = transposeTileBitmap(nonzeroA, blocksPerSide);
+		else
+			nonzeroB = buildTileBitmap(operandB, layoutB, info->sizeB, scheduler->dimension, blockSize);
+	}
+
+	// output tiles outside the row tiles of changed rows and column tiles of changed columns keep their value
+	char* dirtyRowTiles = NULL, *dirtyColumnTiles = NULL;
+
+	if (scheduler->dirtyRows != NULL)
+	{
+		dirtyRowTiles = (char*)calloc(blocksPerSide, 1);
+		dirtyColumnTiles = (char*)calloc(blocksPerSide, 1);
+
+		if (dirtyRowTiles == NULL || dirtyColumnTiles == NULL)
+		{
+			printf("Out of memory\n");
+			exit(-1);
+		}
+
+		// a changed row of A is also a changed column of A^T
+		for (int i = 0; i < scheduler->dimension; i++)
+		{
+			dirtyRowTiles[i / blockSize] |= scheduler->dirtyRows[i];
+			dirtyColumnTiles[i / blockSize] |= scheduler->dirtyColumns[i] | (scheduler->symmetric && scheduler->dirtyRows[i]);
+		}
+
+		clearDirty(scheduler);
+	}
+
+	// the B side of a symmetric product is A^T
+	MatrixStructure structureB = scheduler->symmetric ? transposeStructure(&scheduler->structureA) : scheduler->structureB;
+
+	// symmetric products pack each tile of A once for both sides
+	PanelCache* panels = scheduler->symmetric ? createPanelCache(blocksPerSide) : NULL;
+
+	// narrow kernels read B in pair or quad order, each tile of B is rearranged on first use and kept for the run
+	size_t packedBytes = 0;
+	TilePacker packB = scheduler->modulus == NULL && scheduler->semiring == semiringArithmetic
+		? getTilePacker(scheduler->type, blockSize, &packedBytes) : NULL;
+	void** packedB = NULL;
+
+	if (packB != NULL && (packedB = (void**)calloc((size_t)blocksPerSide * blocksPerSide, sizeof(void*))) == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
 	// create the thread pool
-	ThreadPool* cpuThreadPool = createThreadPool(MAX_CPU_THREADS, MAX_CPU_THREADS);
+	ThreadPool* cpuThreadPool = startCPUPool(scheduler);
 
 	// gpu not setup yet
 #ifndef DISABLE_GPU
@@ -66,6 +1194,11 @@ void runScheduler(Scheduler* scheduler)
 	// set the scheduler passer
 	SchedPass* schedPass = NULL;
 
+#ifndef DISABLE_GPU
+	// gpu tiles are collected here so one dispatch covers several of them
+	GPUBatch* gpuBatch = NULL;
+#endif
+
 	// start assigning jobs
 	while (1)
 	{
@@ -76,9 +1209,16 @@ void runScheduler(Scheduler* scheduler)
 			if (addJob(cpuThreadPool, multiplyCPU, (void*)schedPass) == queueFull)
 			{
 #ifndef DISABLE_GPU
-				if (schedPass->localID == 0 || addJob(gpuThreadPool, multiplyGPU, (void*)schedPass) == queueFull)
+				if (schedPass->localID == 0 || !gpuSupportsType(schedPass->type) || schedPass->accumulate != accumulateNative
+					|| schedPass->semiring != semiringArithmetic || schedPass->modulus != NULL
+					|| batchGPU(&gpuBatch, schedPass) == queueFull)
 #endif
 				{
+#ifndef DISABLE_GPU
+					// the cpu may be waiting on tiles in a partial batch so let the gpu have them
+					submitGPUBatch(&gpuBatch);
+#endif
+
 					// no block used
 					remBlocks++;
 				}
@@ -98,40 +1238,115 @@ void runScheduler(Scheduler* scheduler)
 					break; // no more jobs
 			}
 
-			rowA = blockNum / blocksPerSide * BLOCK_SIZE;
-			colA = blockNum % blocksPerSide * BLOCK_SIZE;
+			rowA = blockNum / blocksPerSide * blockSize;
+			colA = blockNum % blocksPerSide * blockSize;
+
+			rowB = blockNum % blocksPerSide * blockSize;
+			colB = colBOffset * blockSize;
+
+			// the lower triangle of a symmetric product is a copy of the upper one
+			if (colA == 0 && scheduler->symmetric && rowA / blockSize > colBOffset)
+			{
+				blockNum += blocksPerSide;
+				continue;
+			}
+
+			if (colA == 0 && dirtyRowTiles != NULL && !dirtyRowTiles[rowA / blockSize] && !dirtyColumnTiles[colBOffset])
+			{
+				blockNum += blocksPerSide;
+				continue;
+			}
+
+			// count the products that reach this output tile
+			if (colA == 0)
+			{
+				groupSize = 0;
+				groupMember = 0;
+
+				for (int k = 0; k < blocksPerSide; k++)
+					groupSize += tileUsed(nonzeroA, &scheduler->structureA, blocksPerSide, blockSize, rowA / blockSize, k)
+						&& tileUsed(nonzeroB, &structureB, blocksPerSide, blockSize, k, colBOffset);
+
+				// nothing reaches it so it is simply zero
+				if (groupSize == 0)
+				{
+					char* output = outputTile(scheduler, rowA, colB, &outputWidth);
 
-			rowB = blockNum % blocksPerSide * BLOCK_SIZE;
-			colB = colBOffset * BLOCK_SIZE;
+					for (int y = 0; y < blockSize; y++)
+						memset(&output[(long)y * outputWidth * sizeOut], 0, (size_t)sizeOut * blockSize);
 
-			// create the packed data
-			if (dataA == NULL)
-				dataA = (int*)malloc(sizeof(int) * BLOCK_SIZE * BLOCK_SIZE);
+					if (scheduler->epilogue != NULL)
+						applyEpilogue(scheduler->epilogue, outputType(scheduler), output, outputWidth, blockSize, blockSize, colB);
 
-			if (dataB == NULL)
-				dataB = (int*)malloc(sizeof(int) * BLOCK_SIZE * BLOCK_SIZE);
+					blockNum += blocksPerSide;
+					continue;
+				}
+			}
 
-			if (dataA == NULL || dataB == NULL)
+			if (!tileUsed(nonzeroA, &scheduler->structureA, blocksPerSide, blockSize, rowA / blockSize, colA / blockSize)
+				|| !tileUsed(nonzeroB, &structureB, blocksPerSide, blockSize, rowB / blockSize, colBOffset))
 			{
-				// stall for memory by re-running the loop
+				blockNum++;
 				continue;
 			}
 
-			// copy the blocks
-			for (int y = 0; y < BLOCK_SIZE; y++)
-				for (int x = 0; x < BLOCK_SIZE; x++)
+			int tileB = rowB / blockSize * blocksPerSide + colBOffset;
+
+			if (dataB == NULL && packedB != NULL && packedB[tileB] != NULL)
+			{
+				dataB = packedB[tileB];
+				ownsB = 0;
+			}
+
+			// get the packed data (or the tiles themselves for tiled layouts)
+			if (panels != NULL)
+			{
+				// tile (k, j) of A^T is the transpose of tile (j, k) of A
+				if (dataA == NULL)
+					dataA = panelTile(panels, scheduler, rowA, colA, 0);
+
+				if (dataB == NULL)
 				{
-					dataA[y * BLOCK_SIZE + x] = scheduler->A[rowA * scheduler->dimension + colA + y * scheduler->dimension + x];
-					dataB[y * BLOCK_SIZE + x] = scheduler->B[rowB * scheduler->dimension + colB + y * scheduler->dimension + x];
+					dataB = panelTile(panels, scheduler, colB, rowB, 1);
+					ownsB = 0;
 				}
 
+				ownsA = 0;
+			}
+			else
+			{
+				if (dataA == NULL)
+					dataA = fetchTile(scheduler->A, scheduler->layoutA, &scheduler->structureA, info->sizeA, scheduler->dimension, blockSize, rowA, colA, &ownsA);
+
+				if (dataB == NULL)
+					dataB = fetchTile(operandB, layoutB, &structureB, info->sizeB, scheduler->dimension, blockSize, rowB, colB, &ownsB);
+			}
+
+			if (packedB != NULL && dataB != NULL && packedB[tileB] == NULL && (packedB[tileB] = malloc(packedBytes)) != NULL)
+			{
+				packB(dataB, packedB[tileB], blockSize);
+
+				if (ownsB)
+					free(dataB);
+
+				dataB = packedB[tileB];
+				ownsB = 0;
+			}
+
+			if (dataA == NULL || dataB == NULL || (packedB != NULL && dataB != packedB[tileB]))
+			{
+				// stall for memory by re-running the loop
+				continue;
+			}
+
 			// create a place to write the data for this group
-			if (colA == 0)
+			if (groupMember == 0)
 			{
-				
-				dataC = (int*)malloc(sizeof(int) * BLOCK_SIZE * BLOCK_SIZE * blocksPerSide);
+				dataC = (char*)malloc((size_t)sizeAccum * blockSize * blockSize * groupSize);
 				groupProgress = (int*)malloc(sizeof(int));
 				*groupProgress = 0;
+				leaderWaiting = (int*)malloc(sizeof(int));
+				*leaderWaiting = 0;
 				groupLock = (pthread_mutex_t*)malloc(sizeof(pthread_mutex_t));
 				groupSignal = (pthread_cond_t*)malloc(sizeof(pthread_cond_t));
 
@@ -152,16 +1367,26 @@ void runScheduler(Scheduler* scheduler)
 			// update the data to pass
 			schedPass = (SchedPass*)malloc(sizeof(SchedPass));
 			schedPass->groupID = colBOffset * blocksPerSide * blocksPerSide + blockNum / blocksPerSide;
-			schedPass->localID = colA / BLOCK_SIZE;
+			schedPass->localID = groupMember;
 			schedPass->groupLock = groupLock;
 			schedPass->groupSignal = groupSignal;
+			schedPass->type = scheduler->type;
+			schedPass->accumulate = scheduler->accumulate;
+			schedPass->semiring = scheduler->semiring;
+			schedPass->modulus = scheduler->modulus;
+			schedPass->epilogue = scheduler->epilogue;
 			schedPass->groupProgress = groupProgress;
+			schedPass->leaderWaiting = leaderWaiting;
 			schedPass->A = dataA;
 			schedPass->B = dataB;
-			schedPass->blocksPerGroup = blocksPerSide;
-			schedPass->dimension = BLOCK_SIZE;
-			schedPass->writeBack = &(dataC[colA * BLOCK_SIZE]);
-			schedPass->outputSpot = &(scheduler->dataOut[rowA * scheduler->dimension + colB]);
+			schedPass->ownsA = ownsA;
+			schedPass->ownsB = ownsB;
+			schedPass->blocksPerGroup = groupSize;
+			schedPass->dimension = blockSize;
+			schedPass->writeBack = &(dataC[(long)groupMember * blockSize * blockSize * sizeAccum]);
+			schedPass->outputSpot = outputTile(scheduler, rowA, colB, &outputWidth);
+			schedPass->outputWidth = outputWidth;
+			schedPass->outputColumn = colB;
 
 			// reset data to null
 			dataA = NULL;
@@ -172,22 +1397,98 @@ void runScheduler(Scheduler* scheduler)
 
 			// update the blocknum
 			blockNum++;
+			groupMember++;
 		}
 	}
 	
+#ifndef DISABLE_GPU
+	// the last partial batch still has to run before the cpu can finish
+	while (submitGPUBatch(&gpuBatch) == queueFull);
+#endif
+
 	// wait for the threads to exit
-	destroyThreadPool(cpuThreadPool, shutdown);
+	finishCPUPool(scheduler, cpuThreadPool);
+
+	free(nonzeroA);
+	free(nonzeroB);
+	free(dirtyRowTiles);
+	free(dirtyColumnTiles);
 
 #ifndef DISABLE_GPU
 	// do not kill the gpu thread pool just simply wait for it to finish
 	waitTillEmptyQueue(gpuThreadPool);
 #endif
+
+	// the shared tiles can only go once every pass is done
+	if (panels != NULL)
+		deletePanelCache(panels);
+
+	if (packedB != NULL)
+	{
+		for (int tile = 0; tile < blocksPerSide * blocksPerSide; tile++)
+			free(packedB[tile]);
+
+		free(packedB);
+	}
+
+	if (ownsCachedB)
+	{
+		free(cachedB);
+		deleteLayout(layoutB);
+	}
+	else if (cachedB != NULL)
+		releaseCache(scheduler->cache, cachedB);
+
+	if (scheduler->symmetric && scheduler->mirror)
+		mirrorTiles(scheduler);
+}
+
+void runScheduler(Scheduler* scheduler)
+{
+	// an incremental run depends on the previous output, and sparse and GF(2) operands are not hashed
+	if (scheduler->cache == NULL || !cachesResults(scheduler->cache) || scheduler->dirtyRows != NULL
+		|| scheduler->sparseA != NULL || scheduler->bitA != NULL)
+	{
+		runProduct(scheduler);
+		return;
+	}
+
+	CacheKey key;
+	resultKey(scheduler, &key);
+
+	size_t bytes = outputBytes(scheduler);
+	void* cached = lookupCache(scheduler->cache, &key, NULL);
+
+	// the same product was already run
+	if (cached != NULL)
+	{
+		memcpy(scheduler->dataOut, cached, bytes);
+		releaseCache(scheduler->cache, cached);
+		return;
+	}
+
+	runProduct(scheduler);
+
+	void* result = malloc(bytes);
+
+	if (result == NULL)
+		return;
+
+	memcpy(result, scheduler->dataOut, bytes);
+
+	if (storeCache(scheduler->cache, &key, result, bytes, NULL))
+		releaseCache(scheduler->cache, result);
+	else
+		free(result);
 }
 
 void deleteScheduler(Scheduler* scheduler)
 {
 	// free the output data
 	free(scheduler->dataOut);
+	free(scheduler->modulus);
+	free(scheduler->epilogue);
+	clearDirty(scheduler);
 
 	// free the scheduler
 	free(scheduler);
@@ -199,7 +1500,8 @@ void killSchedulerGPU()
 	// force the thread to kill opengl
 	addJob(gpuThreadPool, destroyGPU, NULL);
 
-	// kill the thread that OpenGL is bound to
+	// kill the thread that OpenGL is bound to, the next product sets it up again
 	destroyThreadPool(gpuThreadPool, shutdown);
+	gpuThreadPool = NULL;
 #endif
 }
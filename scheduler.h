@@ -3,30 +3,184 @@
 
 #include <pthread.h>
 
+#include "matrixLayout.h"
+#include "elementType.h"
+#include "threadPool.h"
+#include "matrixFile.h"
+#include "sparseMatrix.h"
+#include "matrixStructure.h"
+#include "bitMatrix.h"
+#include "modular.h"
+#include "epilogue.h"
+#include "matrixCache.h"
+
+// workers in every cpu thread pool
+#define MAX_CPU_THREADS 40
+
+// products with at most this many columns in B skip the tiling and run as dot products
+#define SKINNY_COLUMNS 16
+
 typedef struct
 {
-	int* A;
-	int* B;
+	void* A;
+	void* B;
+	ElementType type;
+	AccumulateMode accumulate;
 	int dimension;
-	int* dataOut;
+	int columns; // columns of B and of the output, dimension for square products
+	int blockSize;
+	MatrixLayout* layoutA; // null when the operand is row major
+	MatrixLayout* layoutB;
+	MatrixLayout* layoutOut; // null for a row major output
+	void* dataOut; // stored as elementInfo[type].outType unless accumulating wide
+	SparseMatrix* sparseA; // A is compressed and B is row major
+	int skipZeroTiles; // scan the operands first and leave out products of all zero tiles
+	int symmetric; // C = A * A^T, only the tiles on and above the diagonal are computed
+	int mirror; // copy the upper triangle of a symmetric product into the lower one
+	MatrixStructure structureA; // triangular and banded operands skip the tiles outside their structure
+	MatrixStructure structureB;
+	BitMatrix* bitA; // GF(2) product, dataOut then holds the packed rows of C
+	BitMatrix* bitB;
+	Semiring semiring;
+	Modulus* modulus; // null unless the product is taken modulo a prime
+	Epilogue* epilogue; // null unless the output is post-processed as it is written
+	char* dirtyRows; // changed rows of A and columns of B, null unless the next run only refreshes what they reach
+	char* dirtyColumns;
+	MatrixCache* cache; // null unless packed panels (and results if the cache keeps them) are looked up by content
+	ThreadPool* cpuPool; // null unless the caller keeps one pool for many runs
 } Scheduler;
 
 typedef struct
 {
 	int groupID, localID;
 	int* groupProgress;
+	int* leaderWaiting; // set while the group's leader waits on its members, null for groups that never reach the gpu
 	pthread_mutex_t* groupLock;
 	pthread_cond_t* groupSignal;
-	int* A;
-	int* B;
-	int blocksPerGroup;
+	ElementType type;
+	AccumulateMode accumulate;
+	Semiring semiring;
+	const Modulus* modulus;
+	const Epilogue* epilogue;
+	void* A;
+	void* B;
+	int ownsA, ownsB; // the tiles were packed for this pass and must be freed
+	int blocksPerGroup; // tile products summed into this output tile
+	int outputWidth; // elements per row of the output
+	int outputColumn; // column of the output tile's first element, for the epilogue's bias
 	int dimension;
-	int* writeBack;
-	int* outputSpot;
+	void* writeBack;
+	void* outputSpot;
 } SchedPass;
 
+// block rows [beginRow, endRow) of a sparse product
+typedef struct
+{
+	SparseMatrix* A;
+	const void* B;
+	void* C;
+	const Epilogue* epilogue;
+	int beginRow, endRow;
+} SparsePass;
+
+// rows [beginRow, endRow) of a product with a skinny B, held transposed
+typedef struct
+{
+	ElementType type;
+	const void* A;
+	const void* B;
+	void* C;
+	const Epilogue* epilogue;
+	int dimension, columns;
+	int beginRow, endRow;
+} SkinnyPass;
+
+// rows [beginRow, endRow) of a GF(2) product
+typedef struct
+{
+	BitMethod method;
+	const uint64_t* A;
+	const uint64_t* B;
+	uint64_t* C;
+	int dimension, words;
+	int beginRow, endRow;
+} BitPass;
+
+// rows [beginRow, endRow) of C += X * Y, or C = X * Y when clear is set
+typedef struct
+{
+	ElementType type;
+	const void* X;
+	const void* Y;
+	void* C;
+	int inner, columns;
+	int clear;
+	int beginRow, endRow;
+} LowRankPass;
+
+// the pool bound to the OpenGL context
+extern ThreadPool* gpuThreadPool;
+
 Scheduler* createScheduler(int* A, int* B, int dimension);
 
+Scheduler* createTypedScheduler(void* A, void* B, int dimension, ElementType type);
+
+// A is dimension x dimension and B is dimension x columns, both row major
+// columns must be at most SKINNY_COLUMNS unless the product is square
+Scheduler* createRectScheduler(void* A, void* B, int dimension, int columns, ElementType type);
+
+// C = A * A^T, every tile of A is packed once and serves both sides of the product
+// without mirror only the upper triangle of C (and the diagonal tiles) is written
+Scheduler* createSyrkScheduler(void* A, int dimension, ElementType type, int mirror);
+
+// C = A * B over GF(2), read dataOut as the words of a BitMatrix of the same dimension
+Scheduler* createBitScheduler(BitMatrix* A, BitMatrix* B);
+
+// multiply straight out of the mapped files, they must stay open while the scheduler runs
+Scheduler* createFileScheduler(MatrixFile* A, MatrixFile* B);
+
+// multiply a compressed A by a row major B, only the stored entries of A are visited
+Scheduler* createSparseScheduler(SparseMatrix* A, void* B);
+
+void setSchedulerAccumulate(Scheduler* scheduler, AccumulateMode accumulate);
+
+// run the tiled product over another semiring, integer entries standing in for infinity must leave room
+// for a sum (INT32_MAX / 2 for int32) since the kernels add without saturating
+void setSchedulerSemiring(Scheduler* scheduler, Semiring semiring);
+
+// int32 products taken mod an odd modulus below 2^31 (0 turns it off), entries must already be in [0, modulus)
+void setSchedulerModulus(Scheduler* scheduler, uint32_t modulus);
+
+// bias, activation and requantization applied to each output tile as it is written (null turns it off)
+// the bias is read from the caller's array while the scheduler runs, GF(2) products take no epilogue
+void setSchedulerEpilogue(Scheduler* scheduler, const Epilogue* epilogue);
+
+int schedulerOutputSize(Scheduler* scheduler);
+
+void setSchedulerSkipZeroTiles(Scheduler* scheduler, int skipZeroTiles);
+
+// null leaves the operand dense, sparse schedulers ignore the structure
+void setSchedulerStructure(Scheduler* scheduler, MatrixStructure* structureA, MatrixStructure* structureB);
+
+void setSchedulerLayout(Scheduler* scheduler, MatrixLayout* layoutA, MatrixLayout* layoutB);
+
+// write the tiled product straight into a layout whose tiles match the scheduler's blocks
+void setSchedulerOutputLayout(Scheduler* scheduler, MatrixLayout* layoutOut);
+
+// the next run keeps dataOut from the previous one and only recomputes the output tiles in the row tiles of
+// the changed rows of A or the column tiles of the changed columns of B, sparse and GF(2) products redo everything
+void setSchedulerDirty(Scheduler* scheduler, const int* rows, int rowCount, const int* columns, int columnCount);
+
+// bring the last result up to date after A += U * V (updateA) or B += U * V, U is dimension x rank and V is rank x
+// dimension (rank x columns for B), row major in the operand type, the operands themselves are left to the caller
+void updateSchedulerLowRank(Scheduler* scheduler, int updateA, const void* U, const void* V, int rank);
+
+// the cache belongs to the caller and has to outlive the scheduler's runs
+void setSchedulerCache(Scheduler* scheduler, MatrixCache* cache);
+
+// the pool belongs to the caller and is waited on rather than destroyed at the end of each run, null starts one per run
+void setSchedulerThreadPool(Scheduler* scheduler, ThreadPool* pool);
+
 void runScheduler(Scheduler* scheduler);
 
 void deleteScheduler(Scheduler* scheduler);
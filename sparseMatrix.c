@@ -0,0 +1,121 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sparseMatrix.h"
+
+int sparseSupportsType(ElementType type)
+{
+	return elementInfo[type].outType == type;
+}
+
+static const char* denseElement(const void* dense, int elementSize, int dimension, MatrixLayout* layout, int row, int col)
+{
+	long offset = layout == NULL ? (long)row * dimension + col : elementOffset(layout, row, col);
+
+	return (const char*)dense + offset * elementSize;
+}
+
+// any non zero byte counts, so -0.0 is kept
+static int blockHasValue(const void* dense, int elementSize, int dimension, MatrixLayout* layout, int blockRow, int blockCol, int blockSize)
+{
+	for (int y = blockRow * blockSize; y < (blockRow + 1) * blockSize; y++)
+		for (int x = blockCol * blockSize; x < (blockCol + 1) * blockSize; x++)
+		{
+			const char* element = denseElement(dense, elementSize, dimension, layout, y, x);
+
+			for (int b = 0; b < elementSize; b++)
+				if (element[b] != 0)
+					return 1;
+		}
+
+	return 0;
+}
+
+SparseMatrix* createSparseMatrix(const void* dense, ElementType type, int dimension, MatrixLayout* layout, SparseFormat format)
+{
+	int blockSize = format == sparseBSR ? SPARSE_BLOCK : 1;
+	int elementSize = elementInfo[type].sizeA;
+
+	if (!sparseSupportsType(type) || dimension % blockSize != 0)
+	{
+		printf("Cannot store a %s matrix of size %i as sparse\n", elementInfo[type].name, dimension);
+		exit(-1);
+	}
+
+	if (layout != NULL && layout->type == layoutRowMajor)
+		layout = NULL;
+
+	SparseMatrix* sparse = (SparseMatrix*)malloc(sizeof(SparseMatrix));
+	int blockRows = dimension / blockSize;
+
+	if (sparse == NULL || (sparse->rowStart = (long*)malloc(sizeof(long) * (blockRows + 1))) == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
+	sparse->format = format;
+	sparse->type = type;
+	sparse->dimension = dimension;
+	sparse->blockSize = blockSize;
+	sparse->blockRows = blockRows;
+
+	// count the entries of each row first so everything is allocated once
+	sparse->rowStart[0] = 0;
+
+	for (int blockRow = 0; blockRow < blockRows; blockRow++)
+	{
+		long count = 0;
+
+		for (int blockCol = 0; blockCol < blockRows; blockCol++)
+			count += blockHasValue(dense, elementSize, dimension, layout, blockRow, blockCol, blockSize);
+
+		sparse->rowStart[blockRow + 1] = sparse->rowStart[blockRow] + count;
+	}
+
+	long entries = sparse->rowStart[blockRows];
+	long blockBytes = (long)elementSize * blockSize * blockSize;
+
+	sparse->colIndex = (int*)malloc(sizeof(int) * (entries > 0 ? entries : 1));
+	sparse->values = malloc(blockBytes * (entries > 0 ? entries : 1));
+
+	if (sparse->colIndex == NULL || sparse->values == NULL)
+	{
+		printf("Out of memory\n");
+		exit(-1);
+	}
+
+	long entry = 0;
+
+	for (int blockRow = 0; blockRow < blockRows; blockRow++)
+		for (int blockCol = 0; blockCol < blockRows; blockCol++)
+		{
+			if (!blockHasValue(dense, elementSize, dimension, layout, blockRow, blockCol, blockSize))
+				continue;
+
+			char* block = (char*)sparse->values + entry * blockBytes;
+
+			for (int y = 0; y < blockSize; y++)
+				for (int x = 0; x < blockSize; x++)
+					memcpy(&block[(y * blockSize + x) * elementSize],
+						denseElement(dense, elementSize, dimension, layout, blockRow * blockSize + y, blockCol * blockSize + x), elementSize);
+
+			sparse->colIndex[entry++] = blockCol;
+		}
+
+	return sparse;
+}
+
+void deleteSparseMatrix(SparseMatrix* sparse)
+{
+	free(sparse->rowStart);
+	free(sparse->colIndex);
+	free(sparse->values);
+	free(sparse);
+}
+
+long sparseEntries(SparseMatrix* sparse)
+{
+	return sparse->rowStart[sparse->blockRows];
+}
@@ -0,0 +1,40 @@
+#ifndef SPARSE_MATRIX_H
+#define SPARSE_MATRIX_H
+
+#include "elementType.h"
+#include "matrixLayout.h"
+
+// side of the dense blocks stored by BSR
+#define SPARSE_BLOCK 4
+
+typedef enum
+{
+	sparseCSR = 0, // one entry per nonzero
+	sparseBSR // one dense SPARSE_BLOCK x SPARSE_BLOCK block per block holding a nonzero
+} SparseFormat;
+
+// compressed rows of a square matrix, for BSR the rows and columns count blocks
+typedef struct
+{
+	SparseFormat format;
+	ElementType type;
+	int dimension;
+	int blockSize; // 1 for CSR
+	int blockRows;
+	long* rowStart; // blockRows + 1 offsets into colIndex
+	int* colIndex;
+	void* values; // blockSize * blockSize row major values per entry
+} SparseMatrix;
+
+// only types that accumulate in their own type (int32, int64, float32, float64) can be stored
+int sparseSupportsType(ElementType type);
+
+// compress a dense matrix stored in layout (null for row major)
+SparseMatrix* createSparseMatrix(const void* dense, ElementType type, int dimension, MatrixLayout* layout, SparseFormat format);
+
+void deleteSparseMatrix(SparseMatrix* sparse);
+
+// stored entries (blocks for BSR)
+long sparseEntries(SparseMatrix* sparse);
+
+#endif
@@ -20,12 +20,14 @@ typedef struct ThreadPool
 	int numThreads;
 	int maxQueueSize;
 	int numPending, numRunning;
+	int numBusy; // threads in the middle of a task
 	int order66; // shutdown the pool
 	int front, back; // the ends of the queue 
 	ThreadTask* queue;
 	pthread_t* thread;
 	pthread_mutex_t lock;
 	pthread_cond_t notification;
+	pthread_cond_t idle; // signalled when the last busy thread finds the queue empty
 	int poolID;
 } ThreadPool;
 
@@ -55,12 +57,22 @@ static void* workerThread(void* passPool)
 		// update the front of the queue
 		threadPool->front = (threadPool->front + 1 == threadPool->maxQueueSize) ? 0 : threadPool->front + 1;
 		threadPool->numPending--;
+		threadPool->numBusy++;
 
 		// unlock the mutex
 		pthread_mutex_unlock(&(threadPool->lock));
 
 		// run the function
 		(*task.function)(task.params);
+
+		pthread_mutex_lock(&(threadPool->lock));
+
+		threadPool->numBusy--;
+
+		if (threadPool->numBusy == 0 && threadPool->numPending == 0)
+			pthread_cond_broadcast(&(threadPool->idle));
+
+		pthread_mutex_unlock(&(threadPool->lock));
 	}
 
 	// reduce the number running
@@ -87,6 +99,7 @@ ThreadPool* createThreadPool(int numThreads, int maxQueueSize)
 	// set to zero
 	threadPool->numPending = 0;
 	threadPool->numRunning = 0;
+	threadPool->numBusy = 0;
 	threadPool->front = 0;
 	threadPool->back = 0;
 	threadPool->order66 = 0;
@@ -110,7 +123,8 @@ ThreadPool* createThreadPool(int numThreads, int maxQueueSize)
 	}
 
 	// create the lock and condition
-	if (pthread_mutex_init(&(threadPool->lock), NULL) != 0 || pthread_cond_init(&(threadPool->notification), NULL) != 0)
+	if (pthread_mutex_init(&(threadPool->lock), NULL) != 0 || pthread_cond_init(&(threadPool->notification), NULL) != 0
+		|| pthread_cond_init(&(threadPool->idle), NULL) != 0)
 	{
 		printf("Cannot create mutex or condition\n");
 		exit(-1);
@@ -197,6 +211,7 @@ static void freeThreadPool(ThreadPool* threadPool)
 		pthread_mutex_lock(&(threadPool->lock));
 		pthread_mutex_destroy(&(threadPool->lock));
 		pthread_cond_destroy(&(threadPool->notification));
+		pthread_cond_destroy(&(threadPool->idle));
 	}
 
 	free(threadPool);
@@ -302,3 +317,43 @@ void waitTillEmptyQueue(ThreadPool* threadPool)
 		exit(-1);
 	}
 }
+
+// unlike waitTillEmptyQueue this also waits for the jobs already taken off the queue to return
+void waitTillIdle(ThreadPool* threadPool)
+{
+	if (pthread_mutex_lock(&(threadPool->lock)) != 0)
+	{
+		printf("Cannot lock.\n");
+		exit(-1);
+	}
+
+	while (threadPool->numPending != 0 || threadPool->numBusy != 0)
+		pthread_cond_wait(&(threadPool->idle), &(threadPool->lock));
+
+	if (pthread_mutex_unlock(&(threadPool->lock)) != 0)
+	{
+		printf("Cannot unlock.\n");
+		exit(-1);
+	}
+}
+
+int queuedJobs(ThreadPool* threadPool)
+{
+	// obtain a lock
+	if (pthread_mutex_lock(&(threadPool->lock)) != 0)
+	{
+		printf("Cannot lock.\n");
+		exit(-1);
+	}
+
+	int pending = threadPool->numPending;
+
+	// unlock the mutex
+	if (pthread_mutex_unlock(&(threadPool->lock)) != 0)
+	{
+		printf("Cannot unlock.\n");
+		exit(-1);
+	}
+
+	return pending;
+}
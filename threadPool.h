@@ -24,4 +24,8 @@ int destroyThreadPool(ThreadPool* threadPool, int shutdownType);
 
 void waitTillEmptyQueue(ThreadPool* threadPool);
 
+void waitTillIdle(ThreadPool* threadPool);
+
+int queuedJobs(ThreadPool* threadPool);
+
 #endif